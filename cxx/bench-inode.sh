@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# $Id$
+#
+# Compares a cold-cache recursive scan in readdir order with one in
+# inode order (--inode-order), on a freshly generated tree.
+#
+# Usage: bench-inode.sh [dir [ndirs [nfiles]]]
+#
+# The tree is built under "dir" (default: ./bench-tree) with "ndirs"
+# directories (default 200) of "nfiles" files each (default 500).  The
+# page, dentry and inode caches are dropped before every run: this
+# needs root privileges, otherwise the runs are warm and the
+# comparison is meaningless.  The tree is scanned with --backup= and
+# has no .tex files, so nothing is ever removed; the timings are those
+# printed by --stats.
+
+DIR=${1:-./bench-tree}
+NDIRS=${2:-200}
+NFILES=${3:-500}
+LTX=${LTX:-./ltx}
+
+if [ ! -d "$DIR" ]; then
+  echo "Building $NDIRS x $NFILES files under $DIR ..."
+  mkdir -p "$DIR"
+  d=0
+  while [ $d -lt $NDIRS ]; do
+    mkdir "$DIR/d$d"
+    d=`expr $d + 1`
+  done
+
+  # The files are created visiting the directories round robin, so
+  # that the inodes of any directory are scattered over the disk.
+
+  f=0
+  while [ $f -lt $NFILES ]; do
+    d=0
+    while [ $d -lt $NDIRS ]; do
+      : > "$DIR/d$d/f$f.aux"
+      d=`expr $d + 1`
+    done
+    f=`expr $f + 1`
+  done
+fi
+
+drop_caches() {
+  sync
+  if [ -w /proc/sys/vm/drop_caches ]; then
+    echo 3 > /proc/sys/vm/drop_caches
+  else
+    echo "warning: cannot drop the caches, the runs are warm" >&2
+  fi
+}
+
+for mode in "" "--inode-order"; do
+  drop_caches
+  echo "--- ltx -r $mode"
+  $LTX -r --backup= --stats $mode "$DIR" > /dev/null
+done
@@ -0,0 +1,148 @@
+#!/bin/sh
+#
+# $Id$
+#
+# Counts the file system calls made by lintex and ltx on generated
+# trees, and checks them against budgets: a change issuing more calls
+# for every directory or every file makes the check fail.
+#
+# Usage: check-syscalls.sh [dir [ndirs [nfiles]]]
+#
+# Two trees are built under "dir" (default: ./syscall-tree), each one
+# with "ndirs" directories (default 10) two levels deep: "noise" has
+# "nfiles" files (default 200) in every directory, none of them related
+# to TeX; "tex" has as many files, in families of a .tex source with a
+# newer .aux and .log (to be removed).  Every program cleans a fresh
+# copy of each tree with -r, with syscount.so (the one named by
+# SYSCOUNT, else built here from syscount.c) preloaded; the system calls
+# counted must not exceed
+#
+#   stat + statx  STAT_PER_DIR x dirs + STAT_PER_CANDIDATE x candidates
+#   openat        OPEN_PER_DIR x dirs
+#   getdents64    GETDENTS_PER_DIR x dirs + entries / ENTRIES_PER_GETDENTS
+#   unlink        removable files
+#   access        ACCESS_PER_REMOVAL x removable files
+#
+# plus SLACK (default 8) for each, where "candidates" are the files
+# having a relevant extension.  A directory read once costs two
+# getdents64 (the entries, then the end), unless it is larger than a
+# buffer of the C library.  The budgets may be changed through the
+# environment; the exit status is 1 if any of them is exceeded.
+
+DIR=${1:-./syscall-tree}
+NDIRS=${2:-10}
+NFILES=${3:-200}
+LINTEX=${LINTEX:-../lintex}
+LTX=${LTX:-./ltx}
+CC=${CC:-cc}
+SRC=`dirname "$0"`
+SYSCOUNT=${SYSCOUNT:-}
+
+: ${STAT_PER_DIR:=3}
+: ${STAT_PER_CANDIDATE:=1}
+: ${OPEN_PER_DIR:=1}
+: ${GETDENTS_PER_DIR:=2}
+: ${ENTRIES_PER_GETDENTS:=500}
+: ${ACCESS_PER_REMOVAL:=1}
+: ${SLACK:=8}
+export STAT_PER_DIR STAT_PER_CANDIDATE OPEN_PER_DIR GETDENTS_PER_DIR
+export ENTRIES_PER_GETDENTS ACCESS_PER_REMOVAL SLACK
+
+mkdir -p "$DIR" || exit 2
+if [ -z "$SYSCOUNT" ]; then
+  SYSCOUNT="$DIR/syscount.so"
+  $CC -shared -fPIC -O2 -o "$SYSCOUNT" "$SRC/syscount.c" -ldl || exit 2
+fi
+case $SYSCOUNT in
+  /*) ;;
+  *)  SYSCOUNT="`pwd`/$SYSCOUNT" ;;
+esac
+
+# The trees: "ndirs" directories, half of them inside the other half
+
+build() {
+  tree="$DIR/$1"
+  rm -rf "$tree"
+  d=0
+  while [ $d -lt $NDIRS ]; do
+    if [ $d -lt `expr $NDIRS / 2` ]; then
+      sub="$tree/d$d"
+    else
+      sub="$tree/d`expr $d - $NDIRS / 2`/e$d"
+    fi
+    mkdir -p "$sub"
+    f=0
+    while [ $f -lt $NFILES ]; do
+      case $1 in
+        noise) : > "$sub/f$f.c";  f=`expr $f + 1`
+               : > "$sub/f$f.png"; f=`expr $f + 1` ;;
+        tex)   : > "$sub/doc$f.tex"
+               touch -t 200001010000 "$sub/doc$f.tex"
+               : > "$sub/doc$f.aux"
+               : > "$sub/doc$f.log"
+               f=`expr $f + 3` ;;
+      esac
+    done
+    d=`expr $d + 1`
+  done
+}
+
+build noise
+build tex
+
+# Runs "program" on a copy of "tree", and checks the calls it made
+
+status=0
+
+check() {
+  program=$1
+  tree=$2
+  dirs=`find "$DIR/$tree" -type d | wc -l`
+  entries=`find "$DIR/$tree" | wc -l`
+  entries=`expr $entries - 1`
+  case $tree in
+    noise) candidates=0; removable=0 ;;
+    tex)   candidates=`find "$DIR/$tree" -type f | wc -l`
+           removable=`find "$DIR/$tree" -name '*.aux' -o -name '*.log' |
+                      wc -l` ;;
+  esac
+
+  rm -rf "$DIR/run" "$DIR/counts"
+  cp -Rp "$DIR/$tree" "$DIR/run"
+  SYSCOUNT_OUT="$DIR/counts" LD_PRELOAD="$SYSCOUNT" \
+    $program -r "$DIR/run" > /dev/null 2>&1
+
+  echo "--- `basename $program` on $tree: $dirs dirs, $entries entries," \
+       "$candidates candidates, $removable removable"
+  awk -v dirs=$dirs -v entries=$entries -v candidates=$candidates \
+      -v removable=$removable '
+    function budget(name, used, limit) {
+      limit += ENVIRON["SLACK"]
+      printf("  %-10s %8d  (budget %d)%s\n", name, used, limit,
+             used > limit ? "  EXCEEDED" : "")
+      if (used > limit) bad = 1
+    }
+    { n[$1] = $2 }
+    END {
+      stats = ENVIRON["STAT_PER_DIR"] * dirs
+      stats += ENVIRON["STAT_PER_CANDIDATE"] * candidates
+      budget("stat", n["stat"] + n["statx"], stats)
+      budget("openat", n["openat"], ENVIRON["OPEN_PER_DIR"] * dirs)
+      reads = ENVIRON["GETDENTS_PER_DIR"] * dirs
+      reads += int(entries / ENVIRON["ENTRIES_PER_GETDENTS"])
+      budget("getdents64", n["getdents64"], reads)
+      budget("unlink", n["unlink"], removable)
+      budget("access", n["access"],
+             ENVIRON["ACCESS_PER_REMOVAL"] * removable)
+      exit bad
+    }' "$DIR/counts" || status=1
+}
+
+for program in "$LINTEX" "$LTX"; do
+  for tree in noise tex; do
+    check "$program" $tree
+  done
+done
+
+rm -rf "$DIR/run" "$DIR/counts"
+exit $status
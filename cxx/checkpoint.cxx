@@ -0,0 +1,292 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include "checkpoint.hh"        // Includes: string, utility, vector, ...
+#include "prune.hh"             // Includes: bitset, string, vector
+
+extern "C" {
+  #include <fcntl.h>
+  #include <unistd.h>
+}
+
+using std::string;
+
+// The checkpoint file holds NUL-terminated text fields: the magic
+// string, the generation, the number of directories, then for every
+// directory its path, device, inode, depth and path hash (see
+// cleandir.cxx), the number of the files of its prune rules and their
+// paths.  The log is a sequence of fixed size binary records, in the
+// byte order of the host.
+
+// Local types and variables
+
+namespace {
+  struct logRecord {
+    unsigned long generation;
+    dev_t         dev;
+    ino_t         ino;
+  };
+
+  const char * const magic = "ltx-checkpoint 2";
+}
+
+// Local functions (declarations)
+
+namespace {
+  bool write_all(int, const string &);
+  bool next_field(std::istream &, string &);
+  template <class T> bool next_number(std::istream &, T &);
+  string sys_error(const char *);
+}
+
+// Methods for the class checkpoint
+
+checkpoint::checkpoint(
+  const string & file
+) : _file(file), _log(file + ".done"), _generation(0), _logFd(-1)
+{
+}
+
+checkpoint::~checkpoint()
+{
+  if (_logFd >= 0) close(_logFd);
+}
+
+bool checkpoint::start(
+  string & error
+) {
+  // A new sweep: forgets any previous checkpoint, and starts an empty
+  // log.
+
+  if (unlink(_file.c_str()) != 0  &&  errno != ENOENT) {
+    error = sys_error("cannot be removed: ");
+    return false;
+  }
+
+  _logFd = open(_log.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,
+                0666);
+  if (_logFd < 0) {
+    error = sys_error("cannot be created: ");
+    return false;
+  }
+  return true;
+}
+
+bool checkpoint::resume(
+  std::vector<savedDir> & frontier,
+  std::vector<dirId>    & done,
+  bool                  & found,
+  string                & error
+) {
+  // Reads the frontier and the directories completed up to the last
+  // checkpoint; "found" is false if there was none, and a new sweep
+  // has been started.
+
+  frontier.clear();
+  done.clear();
+
+  std::ifstream in(_file.c_str(), std::ios::binary);
+
+  if (! in) {
+    found = false;
+    if (errno != ENOENT) {
+      error = sys_error("cannot be read: ");
+      return false;
+    }
+    return start(error);
+  }
+  found = true;
+
+  string        field;
+  unsigned long count;
+
+  if (! next_field(in, field)  ||  field != magic  ||
+      ! next_number(in, _generation)  ||  ! next_number(in, count)) {
+    error = "is not a checkpoint";
+    return false;
+  }
+
+  for (unsigned long i = 0;  i < count;  i++) {
+    savedDir      dir;
+    unsigned long sources;
+
+    if (! next_field(in, dir.name)  ||  ! next_number(in, dir.dev)  ||
+        ! next_number(in, dir.ino)  ||  ! next_number(in, dir.depth)  ||
+        ! next_number(in, dir.pathHash)  ||  ! next_number(in, sources)) {
+      error = "is truncated";
+      return false;
+    }
+    dir.sources.resize(sources);
+    for (unsigned long j = 0;  j < sources;  j++) {
+      if (! next_field(in, dir.sources[j])) {
+        error = "is truncated";
+        return false;
+      }
+    }
+    frontier.push_back(dir);
+  }
+
+  // The log is read up to the first record newer than the frontier
+  // (or incomplete), and cut there.
+
+  _logFd = open(_log.c_str(), O_RDWR | O_CREAT | O_APPEND, 0666);
+  if (_logFd < 0) {
+    error = string(_log) + ' ' + sys_error("cannot be opened: ");
+    return false;
+  }
+
+  logRecord r;
+  off_t     valid = 0;
+
+  while (read(_logFd, &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r))  &&
+         r.generation <= _generation) {
+    done.push_back(dirId(r.dev, r.ino));
+    valid += sizeof(r);
+  }
+
+  if (ftruncate(_logFd, valid) != 0) {
+    error = string(_log) + ' ' + sys_error("cannot be truncated: ");
+    return false;
+  }
+  return true;
+}
+
+bool checkpoint::save(
+  const std::vector<dirTask> & frontier,
+  const std::vector<dirId>   & done,
+  string                     & error
+) {
+  // Appends "done" to the log, then replaces the checkpoint with
+  // "frontier"; both are flushed to the disk before the rename.
+
+  unsigned long generation = _generation + 1;
+
+  if (! done.empty()) {
+    std::vector<logRecord> records(done.size());
+
+    for (std::vector<dirId>::size_type i = 0;  i < done.size();  i++) {
+      records[i].generation = generation;
+      records[i].dev        = done[i].first;
+      records[i].ino        = done[i].second;
+    }
+
+    string bytes(reinterpret_cast<const char *>(&records[0]),
+                 records.size() * sizeof(logRecord));
+
+    if (! write_all(_logFd, bytes)  ||  fdatasync(_logFd) != 0) {
+      error = string(_log) + ' ' + sys_error("cannot be written: ");
+      return false;
+    }
+  }
+
+  std::ostringstream out;
+
+  out << magic << '\0' << generation << '\0' << frontier.size() << '\0';
+
+  for (std::vector<dirTask>::const_iterator iter = frontier.begin();
+       iter != frontier.end();  iter++) {
+    static const std::vector<string> none;
+    const std::vector<string> & sources =
+      iter->rules ? iter->rules->sources() : none;
+
+    out << iter->name << '\0' << iter->dev << '\0' << iter->ino << '\0'
+        << iter->depth << '\0' << iter->pathHash << '\0'
+        << sources.size() << '\0';
+    for (std::vector<string>::const_iterator jter = sources.begin();
+         jter != sources.end();  jter++) {
+      out << *jter << '\0';
+    }
+  }
+
+  std::ostringstream tmpName;
+  tmpName << _file << ".tmp." << getpid();
+
+  string tmp = tmpName.str();
+  int    fd  = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+  if (fd < 0) {
+    error = string(tmp) + ' ' + sys_error("cannot be created: ");
+    return false;
+  }
+
+  bool written = write_all(fd, out.str())  &&  fsync(fd) == 0;
+  if (close(fd) != 0) written = false;
+
+  if (! written  ||  rename(tmp.c_str(), _file.c_str()) != 0) {
+    error = sys_error("cannot be written: ");
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  _generation = generation;
+  return true;
+}
+
+void checkpoint::finish()
+{
+  // The sweep is complete: nothing is left to resume.
+
+  unlink(_file.c_str());
+  if (_logFd >= 0) {
+    close(_logFd);
+    _logFd = -1;
+  }
+  unlink(_log.c_str());
+}
+
+namespace {
+  bool write_all(
+    int            fd,
+    const string & bytes
+  ) {
+    // Writes all of "bytes" to "fd", even in several chunks
+
+    string::size_type done = 0;
+
+    while (done < bytes.size()) {
+      ssize_t n = write(fd, bytes.data() + done, bytes.size() - done);
+
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  bool next_field(
+    std::istream & in,
+    string       & field
+  ) {
+    return std::getline(in, field, '\0');
+  }
+
+  template <class T>
+  bool next_number(
+    std::istream & in,
+    T            & value
+  ) {
+    string field;
+    if (! next_field(in, field)) return false;
+
+    std::istringstream is(field);
+    return (is >> value)  &&  is.eof();
+  }
+
+  string sys_error(
+    const char * what
+  ) {
+    return string(what) + std::strerror(errno);
+  }
+}
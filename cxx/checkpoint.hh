@@ -0,0 +1,80 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "sched.hh"             // Includes: list, string, vector, ...
+
+extern "C" {
+  #include <sys/types.h>
+}
+
+// The checkpoints of a sweep ("options::checkpoint").
+//
+// While the scheduler runs, its checkpoint thread saves, every
+// "options::checkpointEvery" seconds, the frontier of the sweep (the
+// directories queued or being scanned) in the checkpoint file, and
+// appends the directories completed since the previous save to a log,
+// whose name is that of the checkpoint plus ".done".  The scanner
+// threads only push the identifiers of the directories they complete
+// into a vector, under the lock they already hold: all the I/O is done
+// by the checkpoint thread.  The directories that timed out are not
+// completed: they stay in the frontier, and when the sweep is over the
+// checkpoint is saved once more with just them (else it is removed by
+// finish()), so that a resume tries them again.
+//
+// Every save has a generation number.  The frontier is written to a
+// temporary file, then renamed over the checkpoint, so that this is
+// always complete; the log records carry the generation of the
+// frontier they precede, and those newer than the checkpoint (written
+// just before a crash) are ignored, and cut away, on resume.
+//
+// The prune rules of a directory are saved as the list of the files
+// they were loaded from (see prune.hh), to be loaded again on resume
+// on top of those given in the options; the git scope is simply looked
+// for again.
+
+struct savedDir {
+  std::string              name;
+  dev_t                    dev;
+  ino_t                    ino;
+  unsigned                 depth;
+  unsigned long            pathHash;
+  std::vector<std::string> sources;     // Files of the prune rules
+};
+
+class checkpoint {
+public:
+  typedef std::pair<dev_t, ino_t> dirId;
+
+private:
+  std::string   _file;
+  std::string   _log;
+  unsigned long _generation;
+  int           _logFd;
+
+  checkpoint & operator = (const checkpoint & rhs);
+  checkpoint(const checkpoint & rhs);
+
+public:
+  explicit checkpoint(const std::string &);
+  ~checkpoint();
+
+  bool start(std::string &);
+  bool resume(std::vector<savedDir> &, std::vector<dirId> &, bool &,
+              std::string &);
+  bool save(const std::vector<dirTask> &, const std::vector<dirId> &,
+            std::string &);
+  void finish();
+};
+
+#endif // CHECKPOINT_H_
@@ -12,219 +12,1029 @@
 // -------------------------------------------------------------------
 
 #include <algorithm>
+#include <istream>
 #include <iterator>
+#include <map>
+#include <set>
 #include <vector>
+#include <cerrno>
 #include <cstring>
-#include "ltx.hh"               // Includes: functional, iostream, string
-#include "cleandir.hh"          // Includes: string
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "checkpoint.hh"        // Includes: string, utility, vector, ...
+#include "cleandir.hh"          // Includes: iosfwd, list, string, ...
 #include "cleanup.hh"           // Includes: string
-#include "file.hh"              // Includes: list, map, string, utility, ctime
+#include "dircache.hh"          // Includes: map, string, vector, ...
+#include "fanout.hh"            // Includes: deque, string, utility, ...
+#include "file.hh"              // Includes: list, map, string, utility, ...
+#include "fnv.hh"               // Includes: string
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "gitindex.hh"          // Includes: map, string, unordered_set
+#include "probes.hh"            // Includes: time.h
+#include "prune.hh"             // Includes: bitset, string, vector
+#include "recorder.hh"          // Includes: string, vector
+#include "spill.hh"             // Includes: cstdio, string, vector, ...
+#include "throttle.hh"          // Includes: pthread.h
 
-extern "C" {
-  #include <dirent.h>
-  #include <sys/stat.h>
-  #include <sys/types.h>
-}
-
-using std::cerr;
+#if defined(DEBUG)
+#include <iostream>
 using std::cout;
+#endif // DEBUG
+
 using std::strcmp;
 using std::string;
+using ltx::decision;
 
 // Local variables
 
 namespace {
-  // In "re" are defined the extensions of the files relevant for
-  // LaTeX; ".tex" is missing, being handled separately.  THIS ARRAY
-  // MUST BE SORTED IN ASCENDING ORDER.
-
-  const char * re[] = {
-    ".aux", ".dvi", ".idx", ".ilg", ".ind",
-    ".lof", ".log", ".lot", ".pdf", ".ps",
-    ".toc"
-  };
-  const size_t nRE = sizeof(re) / sizeof(re[0]);
-  std::vector<string> texExts(re, re + nRE);
-
   const string tex(".tex");
-  const string dot(".");
+  const char   ignoreFile[] = ".lintexignore";
+  const char   gitDir[]     = ".git";
 
-  const size_t filename_max = 256;
+  // Bounds on the memory used by scan_list(): directories whose files
+  // are held at the same time, and files held over all of them.
+
+  const std::list<string>::size_type maxGroups = 256;
+  const unsigned long                maxHeld   = 65536;
 }
 
 // Local functions (declarations)
 
 namespace {
-  void check_file(const string &, const time_t, currDir &);
+  void scan_dir(runContext &, const dirTask &, taskList &);
+  void examine_entry(runContext &, const string &, const string &,
+                     currDir &, taskList &, ltx::dirCache::state * = 0);
+  void examine_inodes(runContext &, const string &,
+                      std::vector<inodeEntry> &, currDir &, taskList &,
+                      ltx::dirCache::state *&, dirSpill &);
+  void spill_check(dirSpill &, currDir &, ltx::dirCache::state *&);
+  void replay_dir(runContext &, const string &,
+                  const ltx::dirCache::state &, currDir &, taskList &);
+  void finish_dir(runContext &, const dirTask &, const string &,
+                  currDir &, const std::vector<string> &, bool, bool,
+                  taskList &, dirSpill * = 0, dirFanout * = 0);
+  void check_file(runContext &, const string &, const fileTime &,
+                  currDir &);
+  void prune_dirs(runContext &, const dirTask &, const string &,
+                  const gitScope &, taskList &);
+  void find_subdir(const string &, const string &, taskList &);
+  unsigned long path_hash(unsigned long, const string &);
+  bool owned(runContext &, const dirTask &);
+  void add_root(runContext &, const dirTask &, repoFinder &, taskList &);
+  bool resume_roots(runContext &, checkpoint &, const pruneRules *,
+                    repoFinder &, taskList &, bool &);
+  bool is_tex(const string &);
+
+  // A directory whose files are being collected by scan_list()
+
+  struct pathGroup {
+    string              dir;
+    std::vector<string> names;
+
+    pathGroup(const string & d) : dir(d) {}
+  };
+
+  typedef std::list<pathGroup>                  groupList;
+  typedef std::map<string, groupList::iterator> groupIndex;
+
+  bool is_backup(runContext &, const string &);
+  bool is_candidate(runContext &, const string &);
+  bool needs_stat(runContext &, const string &, unsigned char, bool);
+  void clean_group(runContext &, const pathGroup &, repoFinder &);
 }
 
 // Code
 
-void scan_dir(
-  const string & name
+void scan_tree(
+  runContext                 & ctx,
+  const std::list<string>    & targets,
+  std::vector<ltx::devStats> & stats
 ) {
-  // Scans the directory "name", building the related instantiation of
-  // the class "currDir" containing all the informations for the
-  // relevant files; then calls "clean_dir" to perform the actual
-  // cleanup.  If the "-r" options has been specified, recurses over
-  // all the directories under the current one.
+  // Scans all the directories in "targets" (and, if the "-r" option
+  // has been given, all the directories under them); on return,
+  // "stats" holds a summary of the work done on every device.
+  //
+  // If "options::shards" is more than one, the sweep is split among
+  // several runs (on several hosts, say) by a stable hash of the path
+  // of every directory relative to its target, down to
+  // "options::shardDepth" levels: every subtree at that depth is
+  // scanned by a single shard, and the directories above it are
+  // scanned by all the shards, but cleaned by one.  At depth 0, the
+  // targets themselves are the subtrees shared out.
 
 #if defined(DEBUG)
-  static bool firstTime(true);
+  cout << "--------------------Relevant extensions ("
+       << ctx.exts.extensions().size() << ")\n";
+  copy(ctx.exts.extensions().begin(), ctx.exts.extensions().end(),
+       std::ostream_iterator<string>(cout, " "));
+  cout << std::endl;
+#endif // DEBUG
+
+  // The device of the targets that cannot be examined does not
+  // matter: scan_dir() will complain about them.  Even the targets
+  // may be on a hung file system, so they are examined through fsops.
+  // A target already met (as another target, or under one given
+  // before) is dropped; but a target given after its subdirectory
+  // still holds it, and the subdirectory is scanned only once.
+
+  // The rules given in the options apply to every target.
+
+  taskList           roots;
+  ltx::opCounters    scratch;
+  pruneRules       * base = new pruneRules;
+  const pruneRules * rules = ctx.keep(base);
+
+  for (std::vector<string>::const_iterator iter = ctx.opts.exclude.begin();
+       iter != ctx.opts.exclude.end();  iter++) {
+    base->add(*iter);
+  }
+
+  // The targets may be inside a git work tree: its index is looked
+  // for in their ancestors.
+
+  repoFinder finder;
+  checkpoint ckpt(ctx.opts.checkpoint);
+  bool       saving = ! ctx.opts.checkpoint.empty();
+  bool       resumed = false;
+  string     error;
+
+  fsops_bind(&ctx, 0, &scratch);
+
+  // When resuming, the roots are the frontier of the checkpoint, if
+  // any; the targets are used only if there was none.
+
+  if (saving  &&  ctx.opts.resume) {
+    if (! resume_roots(ctx, ckpt, rules, finder, roots, resumed)) {
+      fsops_bind(0, 0, 0);
+      return;
+    }
+  } else if (saving  &&  ! ckpt.start(error)) {
+    ctx.report(ctx.opts.checkpoint, decision::skipped, error);
+    fsops_bind(0, 0, 0);
+    return;
+  }
+
+  // Without "-r" (or at depth 0), every target is a subtree of its
+  // own, as far as sharding is concerned: those owned by other shards
+  // are not even scanned.
+
+  if (! resumed) {
+    for (std::list<string>::const_iterator iter = targets.begin();
+         iter != targets.end();  iter++) {
+      dirTask root(*iter, 0, 0, rules);
+
+      root.pathHash = fnvBasis;
+      if (! ctx.opts.recurse  ||  ctx.opts.shardDepth == 0) {
+        root.depth    = ctx.opts.shardDepth;
+        root.pathHash = path_hash(fnvBasis, *iter);
+        if (! owned(ctx, root)) continue;
+      }
+      add_root(ctx, root, finder, roots);
+    }
+  }
 
-  if (firstTime) {
-    cout << "--------------------Relevant extensions ("
-         << nRE << ")\n";
-    copy(texExts.begin(), texExts.end(),
-         std::ostream_iterator<string>(cout, " "));
-    cout << std::endl;
-    firstTime = false;
+  fsops_bind(0, 0, 0);
+  sched_run(ctx, roots, scan_dir, stats, saving ? &ckpt : 0);
+}
+
+void scan_list(
+  runContext                 & ctx,
+  std::istream               & in,
+  std::vector<ltx::devStats> & stats
+) {
+  // Cleans the files whose paths are read from "in", delimited by NUL
+  // characters, without reading any directory: the paths are grouped
+  // by their parent directory, and every group is cleaned as if it
+  // were the content of that directory.  Only the names that may be
+  // relevant are kept, and only the members of families having a .tex
+  // in the group (plus the backup files) are examined with stat.
+  //
+  // The groups are held in least recently used order; when there are
+  // too many of them (or too many names), the oldest one is cleaned
+  // and dropped.  The paths from "find" and the like come mostly
+  // grouped already; if a directory shows up again after having been
+  // dropped, its families may be split among two groups: this may
+  // keep files that could have been removed, but never removes a
+  // file that should have been kept.
+  //
+  // All the work is done by the calling thread, and is accounted in
+  // "stats" as done on a single device numbered 0.
+
+  const ltx::options & opts = ctx.opts;
+  opThrottle           throttle(opts.maxOpsPerSec, 1,
+                                opts.adaptive, opts.targetLatency);
+  ltx::devStats        s;
+  groupList            groups;
+  groupIndex           index;
+  repoFinder           finder;
+  unsigned long        held(0);
+  string               path;
+
+  fsops_bind(&ctx, &throttle, &s.counters);
+  double first = mono_time();
+
+  while (std::getline(in, path, '\0')) {
+    if (path.empty()) continue;
+
+    string::size_type slash = path.rfind('/');
+    string dir  = slash == string::npos ? "" : path.substr(0, slash + 1);
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+
+    s.counters.entries++;
+    if (! is_candidate(ctx, name)) continue;
+
+    // Moves the group of "dir" (possibly a new one) to the front
+
+    groupIndex::iterator where = index.find(dir);
+
+    if (where == index.end()) {
+      groups.push_front(pathGroup(dir));
+      index[dir] = groups.begin();
+      s.counters.dirs++;
+    } else if (where->second != groups.begin()) {
+      groups.splice(groups.begin(), groups, where->second);
+    }
+
+    groups.front().names.push_back(name);
+    held++;
+
+    while (groups.size() > maxGroups  ||
+           (held > maxHeld  &&  groups.size() > 1)) {
+      clean_group(ctx, groups.back(), finder);
+      held -= groups.back().names.size();
+      index.erase(groups.back().dir);
+      groups.pop_back();
+    }
   }
 
-  cout << "--------------------scan_dir called for \""
-       << name << "\"\n";
+  // Cleans the groups left, oldest first
+
+  while (! groups.empty()) {
+    clean_group(ctx, groups.back(), finder);
+    groups.pop_back();
+  }
+
+  fsops_bind(0, 0, 0);
+
+  s.dev         = 0;
+  s.ops         = throttle.operations();
+  s.meanLatency = throttle.meanLatency();
+  s.elapsed     = mono_time() - first;
+  stats.push_back(s);
+}
+
+namespace {
+  void add_root(
+    runContext    & ctx,
+    const dirTask & target,
+    repoFinder    & finder,
+    taskList      & roots
+  ) {
+    // Appends to "roots" the target "target" (whose name, rules and
+    // shard fields are given), with its device and inode numbers and
+    // the git scope of its ancestors; fsops must be bound.
+
+    const string & name = target.name;
+    dirTask        root(target);
+    struct stat    sStat;
+
+    if (fs_stat(name, &sStat) != 0) {
+      roots.push_back(root);
+      return;
+    }
+
+    if (ctx.opts.git) {
+      string            dir   = name;
+      string::size_type slash = dir.rfind('/');
+
+      if (! S_ISDIR(sStat.st_mode)) {
+        dir.erase(slash == string::npos ? 0 : slash + 1);
+      } else if (*(dir.rbegin()) != '/') {
+        dir.append("/");
+      }
+      root.git = finder.find(ctx, dir);
+    }
+
+    if (! S_ISDIR(sStat.st_mode)  ||
+        ctx.firstVisit(sStat.st_dev, sStat.st_ino)) {
+      root.dev = sStat.st_dev;
+      root.ino = sStat.st_ino;
+      roots.push_back(root);
+    }
+  }
+
+  bool resume_roots(
+    runContext       & ctx,
+    checkpoint       & ckpt,
+    const pruneRules * base,
+    repoFinder       & finder,
+    taskList         & roots,
+    bool             & found
+  ) {
+    // Fills "roots" with the frontier of the checkpoint "ckpt", after
+    // marking as visited the directories already completed; "found"
+    // is false (and a new sweep has been started) if there was no
+    // checkpoint.  The prune rules of the frontier are loaded again,
+    // once for every distinct list of files, on top of "base".
+
+    std::vector<savedDir>          frontier;
+    std::vector<checkpoint::dirId> done;
+    string                         error;
+
+    if (! ckpt.resume(frontier, done, found, error)) {
+      ctx.report(ctx.opts.checkpoint, decision::skipped, error);
+      return false;
+    }
+    if (! found) return true;
+
+    for (std::vector<checkpoint::dirId>::const_iterator iter = done.begin();
+         iter != done.end();  iter++) {
+      ctx.firstVisit(iter->first, iter->second);
+    }
+
+    std::map<std::vector<string>, const pruneRules *> loaded;
+
+    for (std::vector<savedDir>::const_iterator iter = frontier.begin();
+         iter != frontier.end();  iter++) {
+      const pruneRules *& rules = loaded[iter->sources];
+
+      if (rules == 0) {
+        pruneRules * local = new pruneRules(*base);
+
+        for (std::vector<string>::const_iterator jter =
+               iter->sources.begin();
+             jter != iter->sources.end();  jter++) {
+          if (! local->load(*jter)) {
+            ctx.report(*jter, decision::skipped, "could not be read");
+          }
+        }
+        rules = ctx.keep(local);
+      }
+
+      dirTask root(iter->name, 0, 0, rules);
+      root.depth    = iter->depth;
+      root.pathHash = iter->pathHash;
+      add_root(ctx, root, finder, roots);
+    }
+    return true;
+  }
+
+  void scan_dir(
+    runContext    & ctx,
+    const dirTask & task,
+    taskList      & subDirs
+  ) {
+    // Scans the directory "name", building the related instantiation
+    // of the class "currDir" containing all the informations for the
+    // relevant files; then calls "clean_dir" to perform the actual
+    // cleanup.  If the "-r" options has been specified, all the
+    // directories under the current one are returned in "subDirs".
+    //
+    // If an operation on the file system times out, the directory
+    // (and the subtree under it) is abandoned.
+
+    const string & name = task.name;
+
+    fs_unstick();
+
+#if defined(DEBUG)
+    cout << "--------------------scan_dir called for \""
+         << name << "\"\n";
 #endif // DEBUG
 
-  DIR * pDir;
+    // In recorder mode, a .tex may be given instead of a directory
+
+    if (ctx.opts.recorder  &&  is_tex(name)) {
+      if (! owned(ctx, task)) return;
 
-  if ((pDir = opendir( name.c_str() )) != 0) {
+      string::size_type slash = name.rfind('/');
+      clean_recorded(ctx, slash == string::npos ? "" : name.substr(0, slash+1),
+                     name.substr(slash + 1), task.git);
+      if (fs_stuck()) ctx.report(name, decision::skipped, "timed out");
+      return;
+    }
 
     string fullName(name);
     if (*(fullName.rbegin()) != '/') fullName.append("/");
 
-    currDir             thisDir(fullName);
-    std::list<string>   subDirs;
-    struct dirent     * pDe;
+    // With a cache of the directories (see dircache.hh), an unchanged
+    // directory is not read again.
+
+    ltx::dirCache        * cache = ctx.opts.recorder ? 0 : ctx.opts.cache;
+    ltx::dirCache::state   seen;
+
+    if (cache) {
+      if (fs_stat(name, &seen.dir, ltx::statTimes) != 0  ||
+          ! S_ISDIR(seen.dir.st_mode)) {
+        cache = 0;
+
+      } else if (cache->find(fullName, seen.dir, seen)) {
+        currDir thisDir(fullName);
+
+        replay_dir(ctx, fullName, seen, thisDir, subDirs);
+        if (! fs_stuck()) {
+          finish_dir(ctx, task, fullName, thisDir, std::vector<string>(),
+                     seen.hasIgnore, seen.hasGit, subDirs);
+        }
+        if (fs_stuck()) {
+          subDirs.clear();
+          ctx.report(name, decision::skipped, "timed out");
+        }
+        return;
+      }
+    }
+
+    dirReader dir(name);
 
-    // Reads every file: skips null inodes (already deleted
-    // files), and the two special files "." and ".." .
+    if (dir.isOpen()) {
+      currDir                 thisDir(fullName);
+      dirSpill                spill(ctx);
+      dirFanout               fanout(ctx, fullName, examine_entry);
+      unsigned long           examined(0);
+      unsigned long           nRead(0);
+      unsigned long           started(0);
 
-    while ((pDe = readdir(pDir)) != 0) {
-      if (pDe->d_ino == 0) continue;
+      LTX_PROBE1(dir_open, name.c_str());
+      if (LTX_PROBE_ENABLED(dir_close)) started = probe_ns();
+      struct dirent         * pDe;
+      std::vector<inodeEntry> entries;
+      unsigned long           held(0);
+      std::vector<string>     texNames;
+      bool                    hasIgnore(false);
+      bool                    hasGit(false);
+      ltx::dirCache::state  * pSeen = cache ? &seen : 0;
+
+      // Reads every file: skips null inodes (already deleted
+      // files), and the two special files "." and ".." .
+
+      while ((pDe = dir.next()) != 0  &&  ! fs_stuck()) {
+        nRead++;
+        if (pDe->d_ino == 0) continue;
 
 #if defined(DEBUG)
-      cout << "Next file: " << pDe->d_name << " - ";
+        cout << "Next file: " << pDe->d_name << " - ";
 #endif // DEBUG
 
-      if (strcmp(pDe->d_name, ".")  == 0) {
+        if (strcmp(pDe->d_name, ".")  == 0) {
 #if defined(DEBUG)
-        cout << "skipped\n";
+          cout << "skipped\n";
 #endif // DEBUG
-        continue;
-      }
+          continue;
+        }
 
-      if (strcmp(pDe->d_name, "..") == 0) {
+        if (strcmp(pDe->d_name, "..") == 0) {
 #if defined(DEBUG)
-        cout << "skipped\n";
+          cout << "skipped\n";
 #endif // DEBUG
-        continue;
+          continue;
+        }
+
+        if (strcmp(pDe->d_name, ignoreFile) == 0) hasIgnore = true;
+        if (strcmp(pDe->d_name, gitDir)     == 0) hasGit    = true;
+
+        // In recorder mode only the .tex files and the subdirectories
+        // matter; the type given by readdir, when known, avoids a stat
+        // for everything else.
+
+        if (ctx.opts.recorder) {
+          if (is_tex(pDe->d_name)) {
+            texNames.push_back(pDe->d_name);
+          } else if (ctx.opts.recurse  &&  pDe->d_type != DT_REG) {
+            find_subdir(fullName, pDe->d_name, subDirs);
+          }
+          continue;
+        }
+
+        if (! needs_stat(ctx, pDe->d_name, pDe->d_type, pSeen != 0)) {
+          continue;
+        }
+
+        // A huge directory is only read here, its entries being
+        // examined by helper threads (see fanout.hh) once there are
+        // more than a chunk of them.  In inode order, the entries are
+        // only collected here, and examined when the whole directory
+        // has been read (or, under a memory cap, whenever they take
+        // more than that).
+
+        if (fanout.active()) {
+          fanout.add(pDe->d_ino, pDe->d_name);
+          continue;
+        }
+
+        if (++examined == dirFanout::chunkSize  &&  ! spill.used()) {
+          if (ctx.opts.inodeOrder) {
+            examine_inodes(ctx, fullName, entries, thisDir, subDirs, pSeen,
+                           spill);
+            held = 0;
+          }
+          if (fanout.start(pSeen != 0)) {
+            fanout.add(pDe->d_ino, pDe->d_name);
+            continue;
+          }
+        }
+
+        if (ctx.opts.inodeOrder) {
+          entries.push_back(inodeEntry(pDe->d_ino, pDe->d_name));
+          held += sizeof(inodeEntry) + entries.back().second.size();
+
+          if (ctx.opts.maxMemory > 0.0  &&  held > ctx.opts.maxMemory) {
+            examine_inodes(ctx, fullName, entries, thisDir, subDirs, pSeen,
+                           spill);
+            held = 0;
+          }
+        } else {
+          examine_entry(ctx, fullName, pDe->d_name, thisDir, subDirs, pSeen);
+          spill_check(spill, thisDir, pSeen);
+        }
       }
 
-      // Gets the file related informations with stat(2) (we need file
-      // type and modification time).  If the call to "stat" fails,
-      // the file is not considered.
+      if (fanout.active()) {
+        if (! fs_stuck()) fanout.finish(thisDir, subDirs, pSeen);
 
-      char tName[filename_max];
-      std::strcpy(tName, fullName.c_str());
-      std::strcat(tName, pDe->d_name);
+      } else if (ctx.opts.inodeOrder) {
+        examine_inodes(ctx, fullName, entries, thisDir, subDirs, pSeen,
+                       spill);
+      }
 
-      struct stat sStat;
+      LTX_PROBE3(dir_close, name.c_str(), nRead,
+                 started ? probe_ns() - started : 0UL);
 
-      if (stat(tName, &sStat) != 0) {
-#if defined(DEBUG)
-        cout << "got error from stat()\n";
-#else
-        cerr << ltx::progname << ": error calling stat("
-             << tName << ")\n";
-#endif // DEBUG
+      // The directory is remembered before being cleaned, with the
+      // times it had before being read
+
+      if (pSeen  &&  ! fs_stuck()) {
+        seen.hasIgnore = hasIgnore;
+        seen.hasGit    = hasGit;
+        cache->store(fullName, seen);
+      }
+
+      if (! fs_stuck()) {
+        finish_dir(ctx, task, fullName, thisDir, texNames, hasIgnore,
+                   hasGit, subDirs, &spill, &fanout);
+      }
+    }
+
+    if (fs_stuck()) {
+      subDirs.clear();
+      ctx.report(name, decision::skipped, "timed out");
+
+    } else if (! dir.isOpen()) {
+      ctx.report(name, decision::skipped,
+                 "could not be opened (or is not a directory)");
+    }
+  }
 
+  void examine_inodes(
+    runContext              & ctx,
+    const string            & fullName,
+    std::vector<inodeEntry> & entries,
+    currDir                 & thisDir,
+    taskList                & subDirs,
+    ltx::dirCache::state   *& pSeen,
+    dirSpill                & spill
+  ) {
+    // Examines the "entries" collected, and empties the vector.  The
+    // stat calls are issued in ascending inode order, and so the
+    // subdirectories are found (and will be visited) in that order:
+    // on a spinning disk, the inode tables are then read mostly
+    // sequentially.
+
+    std::sort(entries.begin(), entries.end());
+
+    for (std::vector<inodeEntry>::const_iterator iter = entries.begin();
+         iter != entries.end()  &&  ! fs_stuck();  iter++) {
+      examine_entry(ctx, fullName, iter->second, thisDir, subDirs, pSeen);
+      spill_check(spill, thisDir, pSeen);
+    }
+
+    entries.clear();
+  }
+
+  void spill_check(
+    dirSpill              & spill,
+    currDir               & thisDir,
+    ltx::dirCache::state *& pSeen
+  ) {
+    // Spills "thisDir" if it holds more than the memory cap (see
+    // spill.hh).  A directory spilled is not cached: its state would
+    // be as large.
+
+    spill.check(thisDir);
+
+    if (pSeen  &&  spill.used()) {
+      std::vector<ltx::dirCache::entry>().swap(pSeen->entries);
+      pSeen = 0;
+    }
+  }
+
+  void replay_dir(
+    runContext                 & ctx,
+    const string               & fullName,
+    const ltx::dirCache::state & seen,
+    currDir                    & thisDir,
+    taskList                   & subDirs
+  ) {
+    // Fills "thisDir" and "subDirs" from the cached state "seen" of
+    // the directory "fullName", as scan_dir() would have done reading
+    // it.  Unless pretending, the relevant files are examined again:
+    // they could have been rewritten since.
+
+    for (std::vector<ltx::dirCache::entry>::const_iterator iter =
+           seen.entries.begin();
+         iter != seen.entries.end()  &&  ! fs_stuck();  iter++) {
+      if (iter->isDir) {
+        if (ctx.opts.recurse) {
+          subDirs.push_back(dirTask(fullName + iter->name, iter->dev,
+                                    iter->ino));
+        }
+      } else if (ctx.opts.pretend) {
+        check_file(ctx, iter->name, iter->mTime, thisDir);
       } else {
-        if (S_ISDIR(sStat.st_mode) != 0) {
-#if defined(DEBUG)
-          cout << "is a directory\n";
-#endif // DEBUG
+        examine_entry(ctx, fullName, iter->name, thisDir, subDirs);
+      }
+    }
+  }
 
-          // If needed, push the subdirectory names in the dedicated
-          // list, for future recursion; plain files are handled by
-          // the local procedure check_file().
+  void finish_dir(
+    runContext                & ctx,
+    const dirTask             & task,
+    const string              & fullName,
+    currDir                   & thisDir,
+    const std::vector<string> & texNames,
+    bool                        hasIgnore,
+    bool                        hasGit,
+    taskList                  & subDirs,
+    dirSpill                  * spill,
+    dirFanout                 * fanout
+  ) {
+    // Cleans the directory "fullName" once read: its files collected
+    // in "thisDir" (and in "spill", if it was too large to be held, or
+    // in "fanout", if it was read by helper threads), or the outputs
+    // recorded for "texNames" (in recorder mode); then prunes its
+    // subdirectories.
 
-          if (ltx::recurse) subDirs.push_back(tName);
+    // A directory holding a ".git" is the top of a work tree, whose
+    // index governs all the subtree.
 
-        } else {
-          check_file(pDe->d_name, sStat.st_mtime, thisDir);
+    gitScope git = task.git;
+
+    if (hasGit  &&  ctx.opts.git) {
+      git = gitScope(ctx.gitIndexFor(task.dev, task.ino, fullName), "");
+    }
+
+    // Looks if some cleanup has to be performed; a directory of
+    // another shard is only passed through.
+
+    if (owned(ctx, task)) {
+      for (std::vector<string>::const_iterator iter = texNames.begin();
+           iter != texNames.end()  &&  ! fs_stuck();  iter++) {
+        clean_recorded(ctx, fullName, *iter, git);
+      }
+
+      if (fs_stuck()) {
+        // Nothing more to do
+
+      } else if (fanout  &&  fanout->active()) {
+        if (! fanout->clean(git)  &&  ! fs_stuck()) {
+          ctx.report(fullName, decision::skipped,
+                     "temporary files could not be used");
+        }
+
+      } else if (spill  &&  spill->used()) {
+        if (! spill->clean(ctx, thisDir, git)  &&  ! fs_stuck()) {
+          ctx.report(fullName, decision::skipped,
+                     "temporary files could not be used");
         }
+
+      } else {
+        clean_files(ctx, thisDir, git);
       }
     }
 
-    // Looks if some cleanup has to be performed
+    if (! subDirs.empty()) {
+      prune_dirs(ctx, task, hasIgnore ? fullName + ignoreFile : "",
+                 git, subDirs);
+    }
+  }
+
+  void prune_dirs(
+    runContext     & ctx,
+    const dirTask  & parent,
+    const string   & ignoreName,
+    const gitScope & git,
+    taskList       & subDirs
+  ) {
+    // Drops from "subDirs" the subdirectories of "parent" that must not
+    // be scanned: those matching the prune rules (the inherited ones
+    // plus those in "ignoreName", if not empty), those on another
+    // file system if "--xdev" was given, those at the sharding depth
+    // belonging to another shard, and those already visited.  The
+    // rules, the git scope and the path hash are passed down to the
+    // ones left.
 
-    clean_files(thisDir);
+    const pruneRules * rules = parent.rules;
 
-    if (ltx::recurse) {
-      for_each(subDirs.begin(), subDirs.end(), std::ptr_fun(scan_dir));
+    if (! ignoreName.empty()) {
+      pruneRules * local = rules ? new pruneRules(*rules) : new pruneRules;
+
+      if (local->load(ignoreName)) {
+        rules = ctx.keep(local);
+      } else {
+        delete local;
+        ctx.report(ignoreName, decision::skipped, "could not be read");
+      }
     }
 
-    closedir(pDir);
-  } else {
-    cerr << ltx::progname << ": \"" << name
-         << "\" could not be opened (or is not a directory)\n";
+    taskList::iterator iter = subDirs.begin();
+
+    while (iter != subDirs.end()) {
+      string::size_type slash = iter->name.rfind('/');
+
+      string            base  = iter->name.substr(slash + 1);
+
+      iter->depth    = parent.depth + 1;
+      iter->pathHash = parent.depth < ctx.opts.shardDepth
+                       ? path_hash(parent.pathHash, base) : parent.pathHash;
+
+      if ((rules  &&  rules->matches(base))  ||
+          (ctx.opts.xdev  &&  iter->dev != parent.dev)  ||
+          (iter->depth == ctx.opts.shardDepth  &&  ! owned(ctx, *iter))  ||
+          ! ctx.firstVisit(iter->dev, iter->ino)) {
+        iter = subDirs.erase(iter);
+      } else {
+        iter->rules = rules;
+        iter->git   = git.below(base);
+        iter++;
+      }
+    }
+  }
+
+  void find_subdir(
+    const string & fullName,
+    const string & dName,
+    taskList     & subDirs
+  ) {
+    // Pushes "dName" in "subDirs" if it is a directory
+
+    string      tName = fullName + dName;
+    struct stat sStat;
+
+    if (fs_stat(tName, &sStat) == 0  &&  S_ISDIR(sStat.st_mode) != 0) {
+      subDirs.push_back(dirTask(tName, sStat.st_dev, sStat.st_ino));
+    }
+  }
+
+  unsigned long path_hash(
+    unsigned long  hash,
+    const string & component
+  ) {
+    // Extends "hash", the FNV-1a (32 bits) of a relative path, with
+    // "component" and a slash; the hash of the empty path is
+    // "fnvBasis".  The value depends only on the names, so that every
+    // host sharing a sweep computes the same one.
+
+    return fnv1a("/", fnv1a(component, hash));
+  }
+
+  bool owned(
+    runContext    & ctx,
+    const dirTask & task
+  ) {
+    // Tells whether the files of "task" are to be cleaned by this
+    // shard: directories below the sharding depth are scanned only if
+    // their ancestor at that depth is owned, and those above it by
+    // every shard, but cleaned by one.
+
+    return ctx.opts.shards <= 1  ||  task.depth > ctx.opts.shardDepth  ||
+           task.pathHash % ctx.opts.shards == ctx.opts.shard;
+  }
+
+  bool is_tex(
+    const string & name
+  ) {
+    return name.size() > tex.size()  &&
+           name.compare(name.size() - tex.size(), tex.size(), tex) == 0;
+  }
+
+  void examine_entry(
+    runContext           & ctx,
+    const string         & fullName,
+    const string         & dName,
+    currDir              & thisDir,
+    taskList             & subDirs,
+    ltx::dirCache::state * pSeen
+) {
+    // Gets the file related informations with stat(2) (we need
+    // file type and modification time).  If the call to "stat"
+    // fails, the file is not considered.  The subdirectories and the
+    // relevant files are appended to "pSeen", if given.
+
+    string      tName = fullName + dName;
+    struct stat sStat;
+
+    if (fs_stat(tName, &sStat) != 0) {
+#if defined(DEBUG)
+      cout << "got error from stat()\n";
+#endif // DEBUG
+      if (! fs_stuck()) {
+        ctx.report(tName, decision::skipped,
+                   string("error calling stat: ") + std::strerror(errno));
+      }
+
+    } else {
+      if (S_ISDIR(sStat.st_mode) != 0) {
+#if defined(DEBUG)
+        cout << "is a directory\n";
+#endif // DEBUG
+
+        // If needed, push the subdirectory names in the dedicated
+        // list, for future recursion (scan_dir will prune them); plain
+        // files are handled by the local procedure check_file().
+
+        if (ctx.opts.recurse) {
+          subDirs.push_back(dirTask(tName, sStat.st_dev, sStat.st_ino));
+        }
+        if (pSeen) {
+          pSeen->entries.push_back(ltx::dirCache::entry(
+            dName, true, fileTime(), sStat.st_dev, sStat.st_ino));
+        }
+
+      } else {
+        check_file(ctx, dName, fileTime(sStat.st_mtim), thisDir);
+        if (pSeen  &&  is_candidate(ctx, dName)) {
+          pSeen->entries.push_back(ltx::dirCache::entry(
+            dName, false, fileTime(sStat.st_mtim), 0, 0));
+        }
+      }
+    }
   }
-}
 
-namespace {
   void check_file(
-    const string & name,
-    const time_t   mTime,
-    currDir      & CDir
+    runContext     & ctx,
+    const string   & name,
+    const fileTime & mTime,
+    currDir        & CDir
   ) {
     // - If the file "name" matches the trailing string identifying
-    //   backup editor files, is removed;
+    //   backup editor files, is inserted in the "currDir" instance as
+    //   such (to be removed);
     // - if it matches a relevant extension, is inserted in the
     //   "currDir" instance.
 
-    string::size_type where;
+    const string      & trailEd  = ctx.opts.trailEd;
+    string::size_type   lTrailEd = trailEd.size();
+    string::size_type   where;
 
-    if (ltx::lTrailEd > 0) {
-      if ((where = name.rfind(ltx::trailEd)) != string::npos) {
-        if ((where + ltx::lTrailEd) == name.size()) {
+    if (lTrailEd > 0) {
+      if ((where = name.rfind(trailEd)) != string::npos) {
+        if ((where + lTrailEd) == name.size()) {
   #if defined(DEBUG)
           cout << "matches the default editor extension\n";
   #endif // DEBUG
-          nuke(CDir.getName(), name);
+          CDir.addBackup(name);
+          LTX_PROBE3(entry_classified, CDir.getName().c_str(), name.c_str(),
+                     3);
           return;
         }
       }
     }
 
-    // Breaks the file name in "basename" and "extension"; and checks
-    // the latter against the known ones (".tex" files are handled
-    // separately).
+    // Breaks the file name in "basename" and "extension", the latter
+    // being the longest relevant suffix (see exttable.hh); ".tex"
+    // files are handled separately.
 
-    if ((where = name.find_last_of(dot)) != string::npos) {
+    if ((where = ctx.exts.split(name)) != string::npos) {
       string       extension = name.substr(where);
       string       basename  = name.substr(0, where);
       fileFamily & fF        = CDir.getFileFamily(basename);
 
+      LTX_PROBE3(entry_classified, CDir.getName().c_str(), name.c_str(),
+                 extension == tex ? 1 : 2);
+
       if (extension == tex) {
         fF.addExtension(mTime, 0);
   #if defined(DEBUG)
         cout << "inserted\n";
   #endif // DEBUG
 
-      } else if (binary_search(texExts.begin(), texExts.end(), extension)) {
+      } else {
         fF.addExtension(mTime, &extension);
   #if defined(DEBUG)
         cout << "extension " << extension << " - inserted\n";
-      } else {
-        cout << "extension not relevant\n";
   #endif // DEBUG
-
       }
 
-  #if defined(DEBUG)
     } else {
-      cout << "no extension\n";
+      LTX_PROBE3(entry_classified, CDir.getName().c_str(), name.c_str(), 0);
+  #if defined(DEBUG)
+      cout << "extension not relevant\n";
   #endif // DEBUG
     }
   }
+
+  bool is_backup(
+    runContext   & ctx,
+    const string & name
+  ) {
+    // Tells whether "name" ends with the trailer of the editor backup
+    // files.
+
+    const string & trailEd = ctx.opts.trailEd;
+
+    return ! trailEd.empty()  &&  name.size() >= trailEd.size()  &&
+           name.compare(name.size() - trailEd.size(), trailEd.size(),
+                        trailEd) == 0;
+  }
+
+  bool is_candidate(
+    runContext   & ctx,
+    const string & name
+  ) {
+    // Tells whether "name" may be a backup file, a .tex or a file with
+    // one of the relevant extensions, just looking at the name.
+
+    return is_backup(ctx, name)  ||  ctx.exts.split(name) != string::npos;
+  }
+
+  bool needs_stat(
+    runContext    & ctx,
+    const string  & name,
+    unsigned char   type,
+    bool            caching
+  ) {
+    // Tells whether the entry "name", of type "type" (as given by
+    // readdir), must be examined with stat: the files that are not
+    // candidates do not matter, unless they may be directories to be
+    // scanned (or remembered in the cache).
+
+    if (is_candidate(ctx, name)  ||  type == DT_UNKNOWN  ||
+        type == DT_LNK) {
+      return true;
+    }
+    return type == DT_DIR  &&  (ctx.opts.recurse  ||  caching);
+  }
+
+  void clean_group(
+    runContext      & ctx,
+    const pathGroup & group,
+    repoFinder      & finder
+  ) {
+    // Cleans the files in "group" as the content of a directory.  The
+    // members of families without a .tex in the group are not examined
+    // with stat: they are kept in any case.  The git work tree holding
+    // the directory, if any, is found through "finder".
+
+    std::set<string>                    texBases;
+    std::vector<string>::const_iterator iter;
+    string::size_type                   where;
+
+    // When sharding, every directory goes to the shard of its path
+
+    dirTask self(group.dir, 0);
+    self.pathHash = path_hash(fnvBasis, group.dir);
+    if (! owned(ctx, self)) return;
+
+    for (iter = group.names.begin();  iter != group.names.end();  iter++) {
+      if ((where = ctx.exts.split(*iter)) != string::npos  &&
+          iter->substr(where) == tex) {
+        texBases.insert(iter->substr(0, where));
+      }
+    }
+
+    fs_unstick();
+
+    currDir  thisDir(group.dir);
+    taskList subDirs;
+    gitScope git;
+
+    if (ctx.opts.git) git = finder.find(ctx, group.dir);
+
+    if (ctx.opts.recorder) {
+      for (iter = group.names.begin();
+           iter != group.names.end()  &&  ! fs_stuck();  iter++) {
+        if (is_tex(*iter)) clean_recorded(ctx, group.dir, *iter, git);
+      }
+      if (fs_stuck()) ctx.report(group.dir, decision::skipped, "timed out");
+      return;
+    }
+
+    for (iter = group.names.begin();
+         iter != group.names.end()  &&  ! fs_stuck();  iter++) {
+      where = ctx.exts.split(*iter);
+
+      if (is_backup(ctx, *iter)  ||
+          (where != string::npos  &&
+           texBases.count(iter->substr(0, where)) != 0)) {
+        examine_entry(ctx, group.dir, *iter, thisDir, subDirs);
+      } else {
+        check_file(ctx, *iter, 0, thisDir);
+      }
+    }
+
+    if (fs_stuck()) {
+      ctx.report(group.dir, decision::skipped, "timed out");
+    } else {
+      clean_files(ctx, thisDir, git);
+    }
+  }
 }
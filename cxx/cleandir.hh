@@ -14,8 +14,16 @@
 #ifndef CLEANDIR_H_
 #define CLEANDIR_H_
 
+#include <iosfwd>
+#include <list>
 #include <string>
+#include <vector>
+#include "sched.hh"             // Includes: list, string, vector, ...
 
-void scan_dir(const std::string &);
+class runContext;
+
+void scan_tree(runContext &, const std::list<std::string> &,
+               std::vector<ltx::devStats> &);
+void scan_list(runContext &, std::istream &, std::vector<ltx::devStats> &);
 
 #endif // CLEANDIR_H_
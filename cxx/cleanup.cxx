@@ -11,27 +11,40 @@
 //
 // -------------------------------------------------------------------
 
-#include <cstdio>
-#include <cctype>
-#include "ltx.hh"               // Includes: functional, iostream, string
-#include "file.hh"              // Includes: list, map, string, utility, ctime
-#include "cleanup.hh"           // Includes: string
+#include <cerrno>
+#include <cstring>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "file.hh"              // Includes: list, map, string, utility, ...
+#include "cleanup.hh"           // Includes: string, file.hh, gitindex.hh
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "probes.hh"            // Includes: time.h
 
-using std::cin;
+#if defined(DEBUG)
+#include <iostream>
 using std::cout;
-using std::string;
+#endif // DEBUG
 
-namespace {
-  const int answerLength(64);
-}
+using std::string;
+using ltx::decision;
 
 void clean_files(
-  const currDir & dir
+  runContext     & ctx,
+  const currDir  & dir,
+  const gitScope & git
 ) {
-  // Loops over all the file families stored in "dir", then loops over
-  // all the extensions in this file family; if a ".tex" file with a
+  // Removes the editor backup files found in "dir"; then loops over
+  // all the file families stored in "dir", and over all the
+  // extensions in every file family: if a ".tex" file with a
   // modification time former than the modification time of the target
-  // file exists, the file is removed.
+  // file exists, the file is removed (unless its extension is one to
+  // keep, see exttable.hh).  Files tracked by git (see "git") are
+  // never removed.  The loop is given up if an operation on the file
+  // system times out.
+
+  for (std::list<string>::const_iterator kter = dir.backups().begin();
+       kter != dir.backups().end()  &&  ! fs_stuck();  kter++) {
+    nuke(ctx, dir.getName(), *kter, git);
+  }
 
   fileCollection::const_iterator iter, iterEnd = dir.end();
 
@@ -40,59 +53,116 @@ void clean_files(
     const fileFamily                   * pFF = iter->second;
     std::list<extInfo>::const_iterator   jter;
     std::list<extInfo>::const_iterator   jterEnd = pFF->end();
+    unsigned long                        members = 0;
+    unsigned long                        removed = 0;
 
     for (jter = pFF->begin();  jter != jterEnd;  jter++) {
 
+      if (fs_stuck()) return;
+      members++;
+
       string fullName = iter->first + jter->first;
 
-      if (pFF->hasTex()) {
-        if (difftime(jter->second, pFF->texMtime()) > 0.0) {
-
-          if (ltx::confirm) {
-            char answer[answerLength], c;
-
-            do {
-              cout << "Remove " << dir.getName()
-                   << fullName << " (y|n) ? ";
-              cin.get(answer, answerLength);
-              if (cin.gcount() < answerLength-1 ) {
-                cin.ignore();
-              }
-              c = tolower(static_cast<unsigned char>(answer[0]));
-            } while (c != 'y'  &&  c != 'n');
-            if (c != 'y') continue;
-          }
-          nuke(dir.getName(), fullName);
+      if (ctx.exts.keep(jter->first)) {
+        ctx.report(dir.getName() + fullName, decision::kept,
+                   jter->first + " files are kept");
+
+      } else if (pFF->hasTex()) {
+        if (jter->second > pFF->texMtime()) {
+
+          if (ctx.opts.confirm  &&
+              ! ctx.confirm(dir.getName() + fullName)) continue;
+          nuke(ctx, dir.getName(), fullName, git);
+          removed++;
 
         } else {
-          cout << dir.getName() << fullName
-               << " not removed; " << iter->first
-               << ".tex is newer\n";
+          ctx.report(dir.getName() + fullName, decision::kept,
+                     iter->first + ".tex is newer");
         }
       } else {
-        cout << dir.getName() << fullName
-             << " not removed; " << iter->first
-             << ".tex does not exist\n";
+        ctx.report(dir.getName() + fullName, decision::kept,
+                   iter->first + ".tex does not exist");
       }
     }
+
+    LTX_PROBE4(family_decided, dir.getName().c_str(), iter->first.c_str(),
+               members, removed);
   }
 }
 
 void nuke(
-  const string & dirName,
-  const string & fileName
+  runContext     & ctx,
+  const string   & dirName,
+  const string   & fileName,
+  const gitScope & git
 ) {
-  // Removes the file "fileName" from the directory "dirName".  If the
-  // preprocessor symbol 'DEBUG' is defined, the file is not actually
-  // removed: but a message is printed on the standard output stream,
-  // informing that the Finger Of Death has been raised to him.
+  // Removes the file "fileName" from the directory "dirName" (unless
+  // pretending, or the file is tracked by git), and reports the
+  // outcome; when reclaiming space, hands it to the reclaimer instead.
+  // If the preprocessor symbol 'DEBUG' is defined, the file is not
+  // actually removed: but a message is printed on the standard output
+  // stream, informing that the Finger Of Death has been raised to him.
 
   string target = dirName + fileName;
 
+  if (git.unreadable()) {
+    ctx.report(target, decision::skipped, "git index could not be read");
+    return;
+  }
+
+  if (git.tracked(fileName)) {
+    ctx.report(target, decision::kept, "tracked by git");
+    return;
+  }
+
+  // When reclaiming space, the file is only a candidate for now
+
+  if (ctx.opts.reclaim > 0.0) {
+    struct stat sStat;
+
+    if (fs_stat(target, &sStat, ltx::statSize) == 0) {
+      ctx.reclaim.offer(ctx, target, sStat);
+    } else if (! fs_stuck()) {
+      ctx.report(target, decision::skipped,
+                 string("error calling stat: ") + std::strerror(errno));
+    }
+    return;
+  }
+
+  // The space held by the file is measured if asked for
+
+  double bytes = 0.0;
+
+  if (ctx.opts.measure) {
+    struct stat sStat;
+    if (fs_stat(target, &sStat, ltx::statSize) == 0) {
+      bytes = sStat.st_blocks * 512.0;
+    }
+  }
+
 #if defined(DEBUG)
   cout << "FOD: " << target << std::endl;
 #else
-  remove(target.c_str());
-  cout << target << " has been removed.\n";
+  if (ctx.opts.pretend) {
+    ctx.report(target, decision::wouldRemove, "", bytes);
+    return;
+  }
+
+  unsigned long started = 0;
+
+  LTX_PROBE1(unlink_start, target.c_str());
+  if (LTX_PROBE_ENABLED(unlink_done)) started = probe_ns();
+
+  int rc  = fs_remove(target);
+  int err = errno;
+
+  LTX_PROBE3(unlink_done, target.c_str(), rc == 0 ? 0 : err,
+             started ? probe_ns() - started : 0UL);
+
+  if (rc == 0) {
+    ctx.report(target, decision::removed, "", bytes);
+  } else if (! fs_stuck()) {
+    ctx.report(target, decision::failed, std::strerror(err));
+  }
 #endif // DEBUG
 }
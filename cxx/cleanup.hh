@@ -16,8 +16,12 @@
 
 #include <string>
 #include "file.hh"
+#include "gitindex.hh"
 
-void clean_files(const currDir &);
-void nuke(const std::string &, const std::string &);
+class runContext;
+
+void clean_files(runContext &, const currDir &, const gitScope &);
+void nuke(runContext &, const std::string &, const std::string &,
+          const gitScope &);
 
 #endif // CLEANUP_H_
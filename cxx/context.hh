@@ -0,0 +1,100 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef CONTEXT_H_
+#define CONTEXT_H_
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+#include "exttable.hh"          // Includes: string, vector
+#include "reclaim.hh"           // Includes: map, queue, string, ...
+
+extern "C" {
+  #include <pthread.h>
+  #include <sys/types.h>
+}
+
+// The state of a single clean, shared by all its threads: the options,
+// the table of the relevant extensions (filled before the scan starts,
+// and read only afterwards), the candidates for space reclaim (if
+// "options::reclaim" is positive, see reclaim.hh), the sink (whose
+// calls are serialized here), the list of the operations given up and
+// the set of the directories already visited.
+//
+// A directory is identified by its device and inode numbers, so that
+// it is scanned once even if reached from overlapping targets, through
+// bind mounts or through symbolic links (which are followed, and may
+// form cycles).  The set is split in "visitedShards" parts, each one
+// with its own lock, chosen by the inode number.
+//
+// The prune rule sets built during the clean (see prune.hh) are handed
+// to keep(), and deleted only when the clean is over; so are the git
+// indexes (see gitindex.hh), loaded once for every work tree.  An index
+// is loaded without holding any lock: its entry is published first,
+// marked as loading, and the threads asking for it meanwhile wait on
+// "_gitLoaded" (a slow repository holds up only those threads).
+
+class gitIndex;
+class pruneRules;
+
+class runContext {
+private:
+  typedef std::pair<dev_t, ino_t> dirId;
+
+  static const unsigned visitedShards = 16;
+
+  pthread_mutex_t _lock;
+  ltx::sink     & _sink;
+
+  std::vector<std::string> _timedOut;
+
+  pthread_mutex_t    _visitedLock[visitedShards];
+  std::set<dirId>    _visited[visitedShards];
+
+  std::list<const pruneRules *> _rules;
+
+  struct gitEntry {
+    const gitIndex * index;
+    bool             loading;
+  };
+
+  pthread_mutex_t            _gitLock;
+  pthread_cond_t             _gitLoaded;
+  std::map<dirId, gitEntry>  _gitIndexes;
+
+  runContext & operator = (const runContext & rhs);
+  runContext(const runContext & rhs);
+
+public:
+  const ltx::options & opts;
+  extTable             exts;
+  reclaimer            reclaim;
+
+  runContext(const ltx::options &, ltx::sink &);
+  ~runContext();
+
+  void report(const std::string &, ltx::decision::action,
+              const std::string & = "", double = 0.0);
+  bool confirm(const std::string &);
+
+  void timedOut(const std::string &);
+  void timedOut(std::vector<std::string> &);
+
+  bool firstVisit(dev_t, ino_t);
+
+  const pruneRules * keep(const pruneRules *);
+
+  const gitIndex * gitIndexFor(dev_t, ino_t, const std::string &);
+};
+
+#endif // CONTEXT_H_
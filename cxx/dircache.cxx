@@ -0,0 +1,87 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <ctime>
+#include "dircache.hh"          // Includes: map, string, vector, pthread.h
+
+using std::string;
+
+// Local functions (declarations)
+
+namespace {
+  bool same_times(const struct stat &, const struct stat &);
+}
+
+// Methods for the class dirCache
+
+ltx::dirCache::dirCache(
+  unsigned long maxDirs
+) : _maxDirs(maxDirs), _hits(0), _misses(0)
+{
+  pthread_mutex_init(&_lock, 0);
+}
+
+ltx::dirCache::~dirCache()
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+bool ltx::dirCache::find(
+  const string      & path,
+  const struct stat & now,
+  state             & found
+) {
+  // Copies in "found" the state of the directory "path", whose current
+  // attributes are "now"; returns false if it is unknown or changed.
+
+  pthread_mutex_lock(&_lock);
+
+  std::map<string, state>::const_iterator where = _dirs.find(path);
+  bool valid = where != _dirs.end()  &&
+               where->second.dir.st_dev == now.st_dev  &&
+               where->second.dir.st_ino == now.st_ino  &&
+               same_times(where->second.dir, now);
+
+  if (valid) {
+    found = where->second;
+    _hits++;
+  } else {
+    _misses++;
+  }
+
+  pthread_mutex_unlock(&_lock);
+  return valid;
+}
+
+void ltx::dirCache::store(
+  const string & path,
+  const state  & s
+) {
+  // Remembers "s" as the state of the directory "path", unless it has
+  // been modified too recently.
+
+  if (s.dir.st_mtime + racyTime > std::time(0)  ||
+      s.dir.st_ctime + racyTime > std::time(0)) return;
+
+  pthread_mutex_lock(&_lock);
+  if (_dirs.size() >= _maxDirs) _dirs.clear();
+  _dirs[path] = s;
+  pthread_mutex_unlock(&_lock);
+}
+
+namespace {
+  bool same_times(
+    const struct stat & a,
+    const struct stat & b
+  ) {
+    return a.st_mtim.tv_sec  == b.st_mtim.tv_sec   &&
+           a.st_mtim.tv_nsec == b.st_mtim.tv_nsec  &&
+           a.st_ctim.tv_sec  == b.st_ctim.tv_sec   &&
+           a.st_ctim.tv_nsec == b.st_ctim.tv_nsec;
+  }
+}
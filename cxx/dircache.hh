@@ -0,0 +1,96 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef DIRCACHE_H_
+#define DIRCACHE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "file.hh"              // Includes: list, map, string, utility, ...
+
+extern "C" {
+  #include <pthread.h>
+  #include <sys/stat.h>
+  #include <sys/types.h>
+}
+
+// The cache of the directories scanned ("options::cache"), shared by
+// successive cleans in the same process (e.g. by "ltx --serve").
+//
+// For every directory read, the cache holds what the scanner needs of
+// it: the relevant files with their modification times, the
+// subdirectories with their device and inode numbers, and whether a
+// ".lintexignore" or a ".git" is there; the other files are not even
+// remembered.  The state is valid as long as the directory has the
+// same device, inode, modification and change times (to the
+// nanosecond): no entry can have been added, removed or renamed.  A
+// directory modified less than "racyTime" seconds before being read
+// is not stored, since it could change again within the resolution
+// of its time stamps.
+//
+// The files may still have been rewritten in place: before removing
+// anything (i.e. when not pretending) the scanner examines again the
+// relevant files found in the cache, without reading the directory.
+//
+// When more than "maxDirs" directories are held, the cache is simply
+// emptied.  All the methods may be called by several threads at once.
+
+namespace ltx {
+
+  class dirCache {
+  public:
+    struct entry {
+      std::string name;
+      bool        isDir;
+      fileTime    mTime;        // Of a file
+      dev_t       dev;          // Of a directory
+      ino_t       ino;
+
+      entry(const std::string & n, bool d, const fileTime & t, dev_t v,
+            ino_t i)
+        : name(n), isDir(d), mTime(t), dev(v), ino(i) {}
+    };
+
+    struct state {
+      struct stat        dir;
+      bool               hasIgnore;
+      bool               hasGit;
+      std::vector<entry> entries;
+
+      state() : hasIgnore(false), hasGit(false) {
+        std::memset(&dir, 0, sizeof(dir));
+      }
+    };
+
+  private:
+    static const time_t racyTime = 2;
+
+    pthread_mutex_t              _lock;
+    std::map<std::string, state> _dirs;
+    unsigned long                _maxDirs;
+    unsigned long                _hits;
+    unsigned long                _misses;
+
+    dirCache & operator = (const dirCache & rhs);
+    dirCache(const dirCache & rhs);
+
+  public:
+    explicit dirCache(unsigned long maxDirs = 65536);
+    ~dirCache();
+
+    bool find(const std::string &, const struct stat &, state &);
+    void store(const std::string &, const state &);
+
+    unsigned long hits()   const { return _hits; }
+    unsigned long misses() const { return _misses; }
+  };
+}
+
+#endif // DIRCACHE_H_
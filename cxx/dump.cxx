@@ -0,0 +1,497 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "dump.hh"              // Includes: fstream, list, map, string, ...
+#include "fnv.hh"               // Includes: string
+#include "memfs.hh"             // Includes: map, string, vector, ...
+
+extern "C" {
+  #include <unistd.h>
+}
+
+using std::string;
+
+// Local variables and types
+
+namespace {
+  const char          magic[]    = "ltx-dump 1\n";
+  const unsigned long maxName    = 65536;         // Names and targets
+  const unsigned long maxContent = 256UL << 20;   // Files read
+
+  typedef std::pair<string, unsigned char> listEntry;
+
+  // A directory being read: its entries are passed to the dumpBackend
+  // when it is closed.
+
+  class dumpDir : public ltx::fsDir {
+  private:
+    ltx::dumpBackend       & _owner;
+    ltx::fsDir             * _pDir;
+    string                   _name;
+    std::vector<listEntry>   _entries;
+
+  public:
+    dumpDir(ltx::dumpBackend & o, ltx::fsDir * p, const string & n)
+      : _owner(o), _pDir(p), _name(n) {}
+    ~dumpDir();
+
+    struct dirent * next();
+  };
+
+  // What a dump tells of a node
+
+  struct nodeInfo {
+    unsigned long parent;
+    string        name;
+    bool          listed;
+    unsigned char type;         // From the listing of the parent
+    bool          statted;
+    unsigned long mode;
+    unsigned long sec;
+    unsigned long nsec;
+    unsigned long size;
+    bool          read;
+    string        content;      // If read
+
+    nodeInfo(unsigned long p, const string & n)
+      : parent(p), name(n), listed(false), type(DT_UNKNOWN),
+        statted(false), mode(0), sec(0), nsec(0), size(0), read(false) {}
+  };
+}
+
+// Local functions (declarations)
+
+namespace {
+  bool          get(std::istream &, unsigned long &);
+  bool          get(std::istream &, string &, unsigned long = maxName);
+  void          random_salt(unsigned long *);
+}
+
+// Methods for the class dumpBackend
+
+ltx::dumpBackend::dumpBackend(
+  fsBackend      & fs,
+  const string   & file,
+  bool             anonymize,
+  const extTable & exts,
+  const string   & trailEd
+) : _fs(fs), _out(file.c_str(), std::ios::out | std::ios::binary |
+                                std::ios::trunc),
+    _lastNode(0), _anonymize(anonymize), _exts(exts), _trailEd(trailEd)
+{
+  pthread_mutex_init(&_lock, 0);
+  random_salt(_salt);
+  _out << magic;
+}
+
+ltx::dumpBackend::~dumpBackend()
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+bool ltx::dumpBackend::close()
+{
+  // Writes out everything; returns false on errors
+
+  pthread_mutex_lock(&_lock);
+  _out.close();
+  bool ok = ! _out.fail();
+  pthread_mutex_unlock(&_lock);
+  return ok;
+}
+
+void ltx::dumpBackend::put(
+  unsigned long n
+) {
+  // Writes "n" in base 128, low digits first
+
+  while (n >= 0x80) {
+    _out.put(static_cast<char>((n & 0x7f) | 0x80));
+    n >>= 7;
+  }
+  _out.put(static_cast<char>(n));
+}
+
+void ltx::dumpBackend::put(
+  const string & s
+) {
+  put(s.size());
+  _out.write(s.data(), s.size());
+}
+
+string ltx::dumpBackend::hide(
+  const string & name
+) const {
+  // Returns the path component "name", hashed if anonymizing.  Only
+  // the trailer of the editor backups and the relevant extension (as
+  // found by the table of the extensions, or ".tex") are kept: the
+  // members of a family still share their stem.
+
+  if (! _anonymize  ||  name.empty()  ||  name == "."  ||  name == "..") {
+    return name;
+  }
+
+  string::size_type cut = name.size();
+
+  if (! _trailEd.empty()  &&  cut > _trailEd.size()  &&
+      name.compare(cut - _trailEd.size(), _trailEd.size(), _trailEd) == 0) {
+    cut -= _trailEd.size();
+  }
+
+  string::size_type where = _exts.split(name.substr(0, cut));
+  if (where != string::npos) cut = where;
+
+  char digits[24];
+  string stem = name.substr(0, cut);
+
+  std::sprintf(digits, "%08lx%08lx", fnv1a(stem, fnvBasis ^ _salt[0]),
+               fnv1a(stem, fnvBasis ^ _salt[1]));
+  return digits + name.substr(cut);
+}
+
+unsigned long ltx::dumpBackend::node(
+  const string & path
+) {
+  // Returns the number of the node "path", writing the records of the
+  // nodes on it not yet seen; must be called with the lock held.
+
+  unsigned long     current = 0;
+  string::size_type start   = 0;
+
+  while (start <= path.size()) {
+    string::size_type slash = path.find('/', start);
+    if (slash == string::npos) slash = path.size();
+
+    string name = path.substr(start, slash - start);
+    start = slash + 1;
+    if (name.empty()  ||  name == ".") continue;
+
+    nodeMap::key_type  key(current, name);
+    nodeMap::iterator  where = _nodes.find(key);
+
+    if (where == _nodes.end()) {
+      _out.put('N');
+      put(current);
+      put(hide(name));
+      where = _nodes.insert(std::make_pair(key, ++_lastNode)).first;
+    }
+    current = where->second;
+  }
+  return current;
+}
+
+void ltx::dumpBackend::target(
+  const string & path
+) {
+  // Records "path" as a target of the clean, hiding every component
+
+  string            hidden;
+  string::size_type start = 0;
+
+  while (start <= path.size()) {
+    string::size_type slash = path.find('/', start);
+    if (slash == string::npos) slash = path.size();
+
+    hidden += hide(path.substr(start, slash - start));
+    if (slash < path.size()) hidden += '/';
+    start = slash + 1;
+  }
+
+  pthread_mutex_lock(&_lock);
+  _out.put('T');
+  put(hidden);
+  pthread_mutex_unlock(&_lock);
+}
+
+void ltx::dumpBackend::listed(
+  const string                 & dir,
+  const std::vector<listEntry> & entries
+) {
+  // Records the entries read from the directory "dir"
+
+  string prefix(dir);
+  if (prefix.empty()  ||  *(prefix.rbegin()) != '/') prefix += '/';
+
+  pthread_mutex_lock(&_lock);
+
+  std::vector<unsigned long> nodes;
+  nodes.reserve(entries.size());
+  for (std::vector<listEntry>::const_iterator iter = entries.begin();
+       iter != entries.end();  iter++) {
+    nodes.push_back(node(prefix + iter->first));
+  }
+
+  _out.put('L');
+  put(node(dir));
+  put(entries.size());
+  for (std::vector<listEntry>::size_type i = 0;  i < entries.size();  i++) {
+    put(nodes[i]);
+    put(entries[i].second);
+  }
+
+  pthread_mutex_unlock(&_lock);
+}
+
+int ltx::dumpBackend::stat(
+  const string & path,
+  struct stat  * pStat,
+  unsigned       fields
+) {
+  // Records the successful calls; the size is always asked for
+
+  int rc = _fs.stat(path, pStat, fields | statSize);
+
+  if (rc == 0) {
+    int err = errno;
+
+    pthread_mutex_lock(&_lock);
+    unsigned long n = node(path);
+    _out.put('S');
+    put(n);
+    put(pStat->st_mode);
+    put(pStat->st_mtim.tv_sec);
+    put(pStat->st_mtim.tv_nsec);
+    put(pStat->st_size);
+    pthread_mutex_unlock(&_lock);
+
+    errno = err;
+  }
+  return rc;
+}
+
+int ltx::dumpBackend::remove(
+  const string & path
+) {
+  return _fs.remove(path);
+}
+
+ltx::fsDir * ltx::dumpBackend::openDir(
+  const string & path
+) {
+  fsDir * pDir = _fs.openDir(path);
+  return pDir ? new dumpDir(*this, pDir, path) : 0;
+}
+
+int ltx::dumpBackend::prefetch(
+  const string & path
+) {
+  return _fs.prefetch(path);
+}
+
+int ltx::dumpBackend::readFile(
+  const string & path,
+  string       & content
+) {
+  // Records the content read, unless anonymizing: a git index would
+  // give away the names that the dump hides.
+
+  int rc = _fs.readFile(path, content);
+
+  if (rc == 0  &&  ! _anonymize  &&  content.size() <= maxContent) {
+    int err = errno;
+
+    pthread_mutex_lock(&_lock);
+    unsigned long n = node(path);
+    _out.put('F');
+    put(n);
+    put(content);
+    pthread_mutex_unlock(&_lock);
+
+    errno = err;
+  }
+  return rc;
+}
+
+// Methods for the class dumpDir
+
+namespace {
+  dumpDir::~dumpDir()
+  {
+    delete _pDir;
+    _owner.listed(_name, _entries);
+  }
+
+  struct dirent * dumpDir::next()
+  {
+    struct dirent * pDe = _pDir->next();
+
+    if (pDe  &&  std::strcmp(pDe->d_name, ".") != 0  &&
+        std::strcmp(pDe->d_name, "..") != 0) {
+      _entries.push_back(listEntry(pDe->d_name, pDe->d_type));
+    }
+    return pDe;
+  }
+}
+
+// Code
+
+bool ltx::load_dump(
+  const string           & file,
+  memBackend             & fs,
+  std::list<string>      & targets,
+  string                 & error
+) {
+  // Fills "fs" with the tree recorded in "file", and "targets" with
+  // the targets of the clean; returns false (and why, in "error") if
+  // the dump cannot be read.
+
+  std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+
+  if (! in) {
+    error = "cannot be opened";
+    return false;
+  }
+
+  char header[sizeof(magic) - 1];
+
+  if (! in.read(header, sizeof(header))  ||
+      std::memcmp(header, magic, sizeof(header)) != 0) {
+    error = "is not a dump of ltx";
+    return false;
+  }
+
+  std::vector<nodeInfo> nodes(1, nodeInfo(0, ""));
+  int                   type;
+
+  while ((type = in.get()) != EOF) {
+    unsigned long n, m, count;
+    string        s;
+    bool          ok = true;
+
+    switch (type) {
+      case 'N':
+        ok = get(in, n)  &&  get(in, s)  &&  n < nodes.size();
+        if (ok) nodes.push_back(nodeInfo(n, s));
+        break;
+
+      case 'T':
+        ok = get(in, s);
+        if (ok) targets.push_back(s);
+        break;
+
+      case 'L':
+        ok = get(in, n)  &&  get(in, count)  &&  n < nodes.size();
+        for (unsigned long i = 0;  ok  &&  i < count;  i++) {
+          ok = get(in, m)  &&  get(in, n)  &&  m < nodes.size();
+          if (ok) {
+            nodes[m].listed = true;
+            nodes[m].type   = static_cast<unsigned char>(n);
+          }
+        }
+        break;
+
+      case 'S':
+        ok = get(in, n)  &&  n < nodes.size();
+        if (ok) {
+          nodeInfo & i = nodes[n];
+          ok = get(in, i.mode)  &&  get(in, i.sec)  &&  get(in, i.nsec)  &&
+               get(in, i.size);
+          i.statted = true;
+        }
+        break;
+
+      case 'F':
+        ok = get(in, n)  &&  n < nodes.size()  &&
+             get(in, nodes[n].content, maxContent);
+        if (ok) nodes[n].read = true;
+        break;
+
+      default:
+        ok = false;
+    }
+
+    if (! ok) {
+      error = "is truncated or corrupted";
+      return false;
+    }
+  }
+
+  // The nodes are added in order, the parents coming first.  Those
+  // never examined with stat are files, unless readdir told otherwise
+  // or they have children.
+
+  std::vector<bool>   parents(nodes.size(), false);
+  std::vector<string> paths(nodes.size());
+
+  for (std::vector<nodeInfo>::size_type i = 1;  i < nodes.size();  i++) {
+    parents[nodes[i].parent] = true;
+  }
+
+  for (std::vector<nodeInfo>::size_type i = 1;  i < nodes.size();  i++) {
+    const nodeInfo & n = nodes[i];
+    bool             isDir;
+
+    paths[i] = paths[n.parent] + '/' + n.name;
+
+    if (n.statted) {
+      isDir = S_ISDIR(n.mode);
+    } else {
+      isDir = parents[i]  ||  n.type == DT_DIR;
+    }
+    fs.add(paths[i], isDir, static_cast<time_t>(n.sec),
+           static_cast<off_t>(n.size), static_cast<long>(n.nsec));
+    if (n.read) fs.setContent(paths[i], n.content);
+  }
+
+  return true;
+}
+
+// Local functions (definitions)
+
+namespace {
+  bool get(
+    std::istream  & in,
+    unsigned long & n
+  ) {
+    // Reads a number written by dumpBackend::put()
+
+    int      c;
+    unsigned shift = 0;
+
+    n = 0;
+    while ((c = in.get()) != EOF) {
+      if (shift < sizeof(n) * 8) {
+        n |= static_cast<unsigned long>(c & 0x7f) << shift;
+      }
+      if ((c & 0x80) == 0) return true;
+      shift += 7;
+    }
+    return false;
+  }
+
+  bool get(
+    std::istream  & in,
+    string        & s,
+    unsigned long   most
+  ) {
+    // Reads a string of "most" bytes at most
+
+    unsigned long size;
+
+    if (! get(in, size)  ||  size > most) return false;
+    s.resize(size);
+    return size == 0  ||  in.read(&s[0], size);
+  }
+
+  void random_salt(
+    unsigned long * salt
+  ) {
+    // Two random numbers, from the kernel if possible
+
+    std::FILE * fp = std::fopen("/dev/urandom", "rb");
+
+    if (fp == 0  ||  std::fread(salt, sizeof(*salt), 2, fp) != 2) {
+      salt[0] = static_cast<unsigned long>(std::time(0));
+      salt[1] = static_cast<unsigned long>(getpid()) * fnvPrime;
+    }
+    if (fp) std::fclose(fp);
+  }
+}
@@ -0,0 +1,113 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef DUMP_H_
+#define DUMP_H_
+
+#include <fstream>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "exttable.hh"          // Includes: string, vector
+#include "fsbackend.hh"         // Includes: string, dirent.h, sys/stat.h
+
+extern "C" {
+  #include <pthread.h>
+}
+
+// Dumps of the metadata seen by the scanner ("ltx --record" and
+// "ltx --replay"), to run the engine again on the shape of a tree that
+// cannot be shared.
+//
+// A dumpBackend stands between the engine and another backend, and
+// writes to a file what it sees: the targets of the clean, the entries
+// of every directory read (name and type), the result of every
+// successful stat (mode, modification time and size) and the content
+// of the files read by the engine (those of git repositories, see
+// gitindex.hh; not when anonymizing).  load_dump() builds from a dump
+// a memBackend (see memfs.hh) holding all of that, and gives back the
+// targets: a clean with the same options then takes the same
+// decisions, on the same shape, without the original tree.
+//
+// With "anonymize", every path component is replaced by a hash of it,
+// salted with random bytes chosen for the dump; only the relevant
+// extension ("exts": ".aux", ".log", or ".tex") and the trailer
+// of the editor backups ("trailEd") are kept, so that the files still
+// fall in the same families.  The names starting with a dot are hashed
+// as well (a replay sees no ".git" nor ".lintexignore"); "." and ".."
+// are kept.
+//
+// The file starts with the line "ltx-dump 1"; then come records of a
+// byte (the type) and of unsigned integers in base 128, low digits
+// first, the last with the high bit clear (strings are a length and
+// the bytes):
+//
+//     'N' parent name           the next node (numbered from 1; the
+//                               parent 0 is the root)
+//     'T' string                a target, as given to the clean
+//     'L' node count {node type}  the entries of a directory, with
+//                               the type from readdir
+//     'S' node mode sec nsec size  the result of stat
+//     'F' node string           the content of a file
+//
+// The other files read by the engine on the side (configurations,
+// .lintexignore and .fls files) are not in the dump.
+
+namespace ltx {
+
+  class memBackend;
+
+  class dumpBackend : public fsBackend {
+  private:
+    typedef std::map< std::pair<unsigned long, std::string>,
+                      unsigned long > nodeMap;
+
+    fsBackend       & _fs;
+    std::ofstream     _out;
+    pthread_mutex_t   _lock;
+    nodeMap           _nodes;
+    unsigned long     _lastNode;
+    bool              _anonymize;
+    extTable          _exts;
+    std::string       _trailEd;
+    unsigned long     _salt[2];
+
+    unsigned long node(const std::string &);
+    std::string   hide(const std::string &) const;
+    void          put(unsigned long);
+    void          put(const std::string &);
+
+    dumpBackend & operator = (const dumpBackend & rhs);
+    dumpBackend(const dumpBackend & rhs);
+
+  public:
+    dumpBackend(fsBackend &, const std::string &, bool, const extTable &,
+                const std::string &);
+    ~dumpBackend();
+
+    bool good() const { return _out.good(); }
+    void target(const std::string &);
+    void listed(const std::string &,
+                const std::vector< std::pair<std::string,
+                                             unsigned char> > &);
+    bool close();
+
+    int     stat(const std::string &, struct stat *, unsigned);
+    int     remove(const std::string &);
+    fsDir * openDir(const std::string &);
+    int     prefetch(const std::string &);
+    int     readFile(const std::string &, std::string &);
+  };
+
+  bool load_dump(const std::string &, memBackend &,
+                 std::list<std::string> &, std::string &);
+}
+
+#endif // DUMP_H_
@@ -0,0 +1,327 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "exttable.hh"          // Includes: string, vector
+
+extern "C" {
+  #include <unistd.h>
+  #include <sys/stat.h>
+}
+
+using std::string;
+using std::vector;
+
+// Local variables
+
+namespace {
+  // The built in relevant extensions; ".tex" is missing, being handled
+  // separately.  Changing this list, bump "cacheVersion".
+
+  const char * builtIn[] = {
+    ".aux", ".dvi", ".idx", ".ilg", ".ind",
+    ".lof", ".log", ".lot", ".pdf", ".ps",
+    ".toc"
+  };
+  const size_t nBuiltIn = sizeof(builtIn) / sizeof(builtIn[0]);
+
+  const string tex(".tex");
+
+  // The cache: a magic string, a version number, the key (the path
+  // of the configuration file, its modification time in seconds and
+  // nanoseconds and its size), then the two tables; strings are
+  // stored as a length and the characters, integers as unsigned long
+  // in the native byte order (the cache is private to the user).
+
+  const char          cacheMagic[] = "LTXRULES";
+  const size_t        lCacheMagic  = 8;
+  const unsigned long cacheVersion = 2;
+}
+
+// Local functions (declarations)
+
+namespace {
+  string cache_name();
+  void   put_word(std::ostream &, unsigned long);
+  bool   get_word(std::istream &, unsigned long &);
+  void   put_strings(std::ostream &, const vector<string> &);
+  bool   get_strings(std::istream &, vector<string> &);
+  void   sort_unique(vector<string> &);
+}
+
+// Methods for the class extTable
+
+extTable::extTable()
+  : _exts(builtIn, builtIn + nBuiltIn)
+{
+}
+
+bool extTable::load(
+  const string & config,
+  string       & error
+) {
+  // Adds the rules in the file "config" to the built in ones, from the
+  // cache if up to date; returns false, with the reason in "error", if
+  // "config" cannot be read or is not valid.
+
+  struct stat sStat;
+
+  if (stat(config.c_str(), &sStat) != 0) {
+    error = string("cannot be read: ") + std::strerror(errno);
+    return false;
+  }
+
+  std::ostringstream key;
+  key << config << '\0' << sStat.st_mtim.tv_sec << '\0'
+      << sStat.st_mtim.tv_nsec << '\0' << sStat.st_size;
+
+  string cache = cache_name();
+  if (! cache.empty()  &&  readCache(cache, key.str())) return true;
+
+  if (! parse(config, error)) return false;
+  if (! cache.empty()) writeCache(cache, key.str());
+  return true;
+}
+
+bool extTable::parse(
+  const string & config,
+  string       & error
+) {
+  std::ifstream in(config.c_str());
+
+  if (! in) {
+    error = string("cannot be read: ") + std::strerror(errno);
+    return false;
+  }
+
+  string   line, word;
+  unsigned lineNo = 0;
+
+  while (std::getline(in, line)) {
+    lineNo++;
+
+    std::istringstream words(line);
+    if (! (words >> word)  ||  word[0] == '#') continue;
+
+    vector<string> * table;
+
+    if (word == "ext") {
+      table = &_exts;
+    } else if (word == "keep") {
+      table = &_keep;
+    } else {
+      std::ostringstream msg;
+      msg << "line " << lineNo << ": unknown rule \"" << word << "\"";
+      error = msg.str();
+      return false;
+    }
+
+    while (words >> word) {
+      if (word.size() < 2  ||  word[0] != '.'  ||  word == tex) {
+        std::ostringstream msg;
+        msg << "line " << lineNo << ": bad extension \"" << word << "\"";
+        error = msg.str();
+        return false;
+      }
+      table->push_back(word);
+    }
+  }
+
+  // The extensions to keep are relevant too
+
+  _exts.insert(_exts.end(), _keep.begin(), _keep.end());
+  sort_unique(_exts);
+  sort_unique(_keep);
+  return true;
+}
+
+bool extTable::readCache(
+  const string & cache,
+  const string & key
+) {
+  std::ifstream in(cache.c_str(), std::ios::in | std::ios::binary);
+  char          magic[lCacheMagic];
+  unsigned long  version;
+  vector<string> keys, exts, keep;
+
+  if (! in.read(magic, lCacheMagic)  ||
+      std::memcmp(magic, cacheMagic, lCacheMagic) != 0  ||
+      ! get_word(in, version)  ||  version != cacheVersion  ||
+      ! get_strings(in, keys)  ||  keys.size() != 1  ||  keys[0] != key  ||
+      ! get_strings(in, exts)  ||  ! get_strings(in, keep)) return false;
+
+  _exts.swap(exts);
+  _keep.swap(keep);
+  return true;
+}
+
+void extTable::writeCache(
+  const string & cache,
+  const string & key
+) const {
+  // Writes the cache in a temporary file, then renames it: a reader
+  // never sees a partial cache.  Failures are silently ignored.
+
+  std::ostringstream tmpName;
+  tmpName << cache << '.' << getpid();
+
+  {
+    std::ofstream out(tmpName.str().c_str(),
+                      std::ios::out | std::ios::binary | std::ios::trunc);
+
+    out.write(cacheMagic, lCacheMagic);
+    put_word(out, cacheVersion);
+    put_strings(out, vector<string>(1, key));
+    put_strings(out, _exts);
+    put_strings(out, _keep);
+
+    if (! out.flush()) {
+      unlink(tmpName.str().c_str());
+      return;
+    }
+  }
+
+  if (rename(tmpName.str().c_str(), cache.c_str()) != 0) {
+    unlink(tmpName.str().c_str());
+  }
+}
+
+string::size_type extTable::split(
+  const string & name
+) const {
+  // Returns the position of the extension of "name" (the first dot of
+  // the longest relevant suffix, or of ".tex"), or string::npos if
+  // "name" has no relevant extension.  The suffixes are compared in
+  // place, without being copied.
+
+  for (string::size_type where = name.find('.');
+       where != string::npos;  where = name.find('.', where + 1)) {
+    if (name.compare(where, string::npos, tex) == 0  ||
+        relevantSuffix(name, where)) return where;
+  }
+
+  return string::npos;
+}
+
+bool extTable::relevantSuffix(
+  const string      & name,
+  string::size_type   where
+) const {
+  // Tells whether the suffix of "name" from "where" is relevant
+
+  vector<string>::size_type low = 0, high = _exts.size();
+
+  while (low < high) {
+    vector<string>::size_type middle = low + (high - low) / 2;
+    int c = name.compare(where, string::npos, _exts[middle]);
+
+    if (c == 0) return true;
+    if (c < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+
+  return false;
+}
+
+bool extTable::relevant(
+  const string & extension
+) const {
+  return std::binary_search(_exts.begin(), _exts.end(), extension);
+}
+
+bool extTable::keep(
+  const string & extension
+) const {
+  return std::binary_search(_keep.begin(), _keep.end(), extension);
+}
+
+namespace {
+  string cache_name() {
+
+    // The cache lives in $XDG_CACHE_HOME, or else in $HOME/.cache; if
+    // neither exists, there is no cache.
+
+    const char * dir = std::getenv("XDG_CACHE_HOME");
+    string       name;
+
+    if (dir  &&  *dir) {
+      name = dir;
+    } else if ((dir = std::getenv("HOME")) != 0  &&  *dir) {
+      name = string(dir) + "/.cache";
+    } else {
+      return "";
+    }
+
+    struct stat sStat;
+    if (stat(name.c_str(), &sStat) != 0  ||  ! S_ISDIR(sStat.st_mode)) {
+      return "";
+    }
+
+    return name + "/ltx-rules.bin";
+  }
+
+  void put_word(
+    std::ostream  & out,
+    unsigned long   value
+  ) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  bool get_word(
+    std::istream  & in,
+    unsigned long & value
+  ) {
+    return in.read(reinterpret_cast<char *>(&value), sizeof(value));
+  }
+
+  void put_strings(
+    std::ostream         & out,
+    const vector<string> & table
+  ) {
+    put_word(out, table.size());
+    for (vector<string>::const_iterator iter = table.begin();
+         iter != table.end();  iter++) {
+      put_word(out, iter->size());
+      out.write(iter->data(), iter->size());
+    }
+  }
+
+  bool get_strings(
+    std::istream   & in,
+    vector<string> & table
+  ) {
+    unsigned long n, size;
+
+    if (! get_word(in, n)) return false;
+
+    for (unsigned long i = 0;  i < n;  i++) {
+      if (! get_word(in, size)  ||  size > 65536) return false;
+
+      string s(size, '\0');
+      if (size > 0  &&  ! in.read(&s[0], size)) return false;
+      table.push_back(s);
+    }
+
+    return true;
+  }
+
+  void sort_unique(
+    vector<string> & table
+  ) {
+    std::sort(table.begin(), table.end());
+    table.erase(std::unique(table.begin(), table.end()), table.end());
+  }
+}
@@ -0,0 +1,58 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef EXTTABLE_H_
+#define EXTTABLE_H_
+
+#include <string>
+#include <vector>
+
+// The table of the extensions relevant for LaTeX.
+//
+// Built in are the extensions of the files that LaTeX and its friends
+// produce from a .tex (".aux", ".log", ".pdf", ...); more may be given
+// in a configuration file, with lines like
+//
+//     # comment
+//     ext  .fls .fdb_latexmk .run.xml .bcf .xdv
+//     keep .pdf
+//
+// where "ext" adds relevant extensions, and "keep" marks extensions
+// whose files are never removed (the final documents, say; they are
+// relevant anyway).  An extension may hold more than one dot: the
+// extension of a file name is the longest relevant suffix starting
+// with a dot, or else ".tex" if the name ends so.
+//
+// The table is kept as two sorted vectors searched by bisection.  A
+// configuration file, once compiled, is cached in a binary file (see
+// exttable.cxx) together with its path, modification time and size,
+// so that it is parsed again only when changed.
+
+class extTable {
+private:
+  std::vector<std::string> _exts;
+  std::vector<std::string> _keep;
+
+  bool parse(const std::string &, std::string &);
+  bool relevantSuffix(const std::string &, std::string::size_type) const;
+  bool readCache(const std::string &, const std::string &);
+  void writeCache(const std::string &, const std::string &) const;
+
+public:
+  extTable();
+
+  bool load(const std::string &, std::string &);
+
+  std::string::size_type split(const std::string &) const;
+  bool                   relevant(const std::string &) const;
+  bool                   keep(const std::string &) const;
+
+  const std::vector<std::string> & extensions() const { return _exts; }
+};
+
+#endif // EXTTABLE_H_
@@ -0,0 +1,369 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "cleanup.hh"           // Includes: string, file.hh, gitindex.hh
+#include "fanout.hh"            // Includes: deque, string, utility, ...
+#include "fnv.hh"               // Includes: string
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "spill.hh"             // Includes: cstdio, string, vector, ...
+
+using std::string;
+
+// Code
+
+dirFanout::shard::shard(
+  const string     & name,
+  const runContext & ctx
+) : dir(name), spill(new dirSpill(ctx, nShards))
+{
+  pthread_mutex_init(&lock, 0);
+}
+
+dirFanout::shard::~shard()
+{
+  delete spill;
+  pthread_mutex_destroy(&lock);
+}
+
+dirFanout::dirFanout(
+  runContext    & ctx,
+  const string  & name,
+  entryFunction   examine
+) : _ctx(ctx), _name(name), _examine(examine), _throttle(0), _counters(0),
+    _caching(false), _busy(0), _closing(false), _stuck(false),
+    _failed(false), _git(0)
+{
+  pthread_mutex_init(&_lock, 0);
+  pthread_cond_init(&_work, 0);
+  pthread_cond_init(&_idle, 0);
+}
+
+dirFanout::~dirFanout()
+{
+  // Stops the helpers, and adds their counters to those of the scanner
+
+  pthread_mutex_lock(&_lock);
+  _closing = true;
+  pthread_cond_broadcast(&_work);
+  pthread_mutex_unlock(&_lock);
+
+  for (std::vector<helper *>::iterator iter = _helpers.begin();
+       iter != _helpers.end();  iter++) {
+    pthread_join((*iter)->id, 0);
+    if (_counters) *_counters += (*iter)->counters;
+    delete *iter;
+  }
+
+  for (std::deque<chunk *>::iterator iter = _chunks.begin();
+       iter != _chunks.end();  iter++) {
+    delete *iter;
+  }
+
+  for (std::vector<shard *>::iterator iter = _shards.begin();
+       iter != _shards.end();  iter++) {
+    delete *iter;
+  }
+
+  pthread_cond_destroy(&_idle);
+  pthread_cond_destroy(&_work);
+  pthread_mutex_destroy(&_lock);
+}
+
+bool dirFanout::start(
+  bool caching
+) {
+  // Starts the helpers (collecting, if "caching", the entries for the
+  // cache of the directories); false if not even one could be.
+
+  runContext * pContext;
+
+  if (_ctx.opts.dirJobs < 2) return false;
+
+  fsops_bound(pContext, _throttle, _counters);
+  _caching = caching;
+
+  for (unsigned i = 0;  i < nShards;  i++) {
+    _shards.push_back(new shard(_name, _ctx));
+  }
+
+  for (unsigned i = 0;  i < _ctx.opts.dirJobs;  i++) {
+    helper * pH = new helper;
+    pH->owner = this;
+
+    if (pthread_create(&pH->id, 0, body, pH) != 0) {
+      delete pH;
+      break;
+    }
+    _helpers.push_back(pH);
+  }
+
+  return active();
+}
+
+void dirFanout::add(
+  ino_t          ino,
+  const string & name
+) {
+  // Queues the entry "name" to be examined by the helpers
+
+  _next.push_back(inodeEntry(ino, name));
+  if (_next.size() >= chunkSize) dispatch();
+}
+
+void dirFanout::finish(
+  currDir              & thisDir,
+  taskList             & subDirs,
+  ltx::dirCache::state *& pSeen
+) {
+  // Waits for all the entries to be examined; then merges the families
+  // in "thisDir" (found before the start) with the others, and gives
+  // back the subdirectories and, if "pSeen" is given, the entries to
+  // be cached (or drops it, if any shard was spilled).  If a helper
+  // timed out, the scanner is marked stuck.
+
+  dispatch();
+  wait();
+
+  absorb(thisDir);
+  thisDir.clear();
+
+  bool spilled = false;
+
+  for (std::vector<shard *>::const_iterator iter = _shards.begin();
+       iter != _shards.end();  iter++) {
+    if ((*iter)->spill->used()) spilled = true;
+  }
+
+  for (std::vector<helper *>::iterator iter = _helpers.begin();
+       iter != _helpers.end();  iter++) {
+    subDirs.splice(subDirs.end(), (*iter)->subDirs);
+
+    if (pSeen  &&  ! spilled) {
+      pSeen->entries.insert(pSeen->entries.end(),
+                            (*iter)->seen.entries.begin(),
+                            (*iter)->seen.entries.end());
+    }
+    std::vector<ltx::dirCache::entry>().swap((*iter)->seen.entries);
+  }
+
+  if (pSeen  &&  spilled) {
+    std::vector<ltx::dirCache::entry>().swap(pSeen->entries);
+    pSeen = 0;
+  }
+
+  if (_stuck) fs_stick();
+}
+
+bool dirFanout::clean(
+  const gitScope & git
+) {
+  // Cleans all the shards in parallel, files tracked by git excepted;
+  // false if a spilled shard could not be read back.
+
+  pthread_mutex_lock(&_lock);
+  _git = &git;
+  for (unsigned i = 0;  i < _shards.size();  i++) _toClean.push_back(i);
+  pthread_cond_broadcast(&_work);
+  pthread_mutex_unlock(&_lock);
+
+  wait();
+
+  if (_stuck) fs_stick();
+  return ! _failed;
+}
+
+void * dirFanout::body(
+  void * arg
+) {
+  helper & h = *static_cast<helper *>(arg);
+  h.owner->run(h);
+  return 0;
+}
+
+void dirFanout::run(
+  helper & h
+) {
+  // Body of a helper thread: examines the chunks queued, and cleans
+  // the shards queued, until the fanout is closed.
+
+  fsops_bind(&_ctx, _throttle, &h.counters);
+
+  pthread_mutex_lock(&_lock);
+
+  for (;;) {
+    while (_chunks.empty()  &&  _toClean.empty()  &&  ! _closing) {
+      pthread_cond_wait(&_work, &_lock);
+    }
+
+    if (_closing) {
+      break;
+
+    } else if (! _chunks.empty()) {
+      chunk * pC = _chunks.front();
+      _chunks.pop_front();
+      _busy++;
+      pthread_cond_broadcast(&_idle);       // Room for another chunk
+      pthread_mutex_unlock(&_lock);
+
+      if (! fs_stuck()) scan(h, *pC);
+      delete pC;
+
+    } else if (! _toClean.empty()) {
+      unsigned which = _toClean.front();
+      _toClean.pop_front();
+      _busy++;
+      pthread_mutex_unlock(&_lock);
+
+      if (! fs_stuck()) cleanShard(which);
+    }
+
+    pthread_mutex_lock(&_lock);
+    if (fs_stuck()) _stuck = true;
+    _busy--;
+    pthread_cond_broadcast(&_idle);
+  }
+
+  pthread_mutex_unlock(&_lock);
+
+  fsops_bind(0, 0, 0);
+}
+
+void dirFanout::scan(
+  helper & h,
+  chunk  & entries
+) {
+  // Examines the "entries" of a chunk (in inode order, if asked for),
+  // and merges the families found with the others.
+
+  if (_ctx.opts.inodeOrder) std::sort(entries.begin(), entries.end());
+
+  currDir found(_name);
+
+  for (chunk::const_iterator iter = entries.begin();
+       iter != entries.end()  &&  ! fs_stuck();  iter++) {
+    _examine(_ctx, _name, iter->second, found, h.subDirs,
+             _caching ? &h.seen : 0);
+  }
+
+  if (! fs_stuck()) absorb(found);
+}
+
+void dirFanout::absorb(
+  currDir & found
+) {
+  // Moves the files of "found" to their shards (the backups, needing
+  // no family, by a hash of their own name): each shard is locked
+  // once, and spilled if holding too much.
+
+  std::vector<unsigned> which, whichBackup;
+
+  for (fileCollection::const_iterator iter = found.begin();
+       iter != found.end();  iter++) {
+    which.push_back(fnv1a(iter->first) % nShards);
+  }
+  for (std::list<string>::const_iterator iter = found.backups().begin();
+       iter != found.backups().end();  iter++) {
+    whichBackup.push_back(fnv1a(*iter) % nShards);
+  }
+
+  for (unsigned s = 0;  s < _shards.size();  s++) {
+    shard                               & sh     = *_shards[s];
+    std::vector<unsigned>::const_iterator jter   = which.begin();
+    bool                                  locked = false;
+
+    for (fileCollection::const_iterator iter = found.begin();
+         iter != found.end();  iter++, jter++) {
+      if (*jter != s) continue;
+      if (! locked) {
+        pthread_mutex_lock(&sh.lock);
+        locked = true;
+      }
+
+      const fileFamily & fF = *iter->second;
+
+      if (fF.hasTex()) {
+        sh.dir.getFileFamily(iter->first).addExtension(fF.texMtime(), 0);
+      }
+      for (std::list<extInfo>::const_iterator kter = fF.begin();
+           kter != fF.end();  kter++) {
+        sh.dir.getFileFamily(iter->first).addExtension(kter->second,
+                                                       &kter->first);
+      }
+    }
+
+    jter = whichBackup.begin();
+    for (std::list<string>::const_iterator iter = found.backups().begin();
+         iter != found.backups().end();  iter++, jter++) {
+      if (*jter != s) continue;
+      if (! locked) {
+        pthread_mutex_lock(&sh.lock);
+        locked = true;
+      }
+      sh.dir.addBackup(*iter);
+    }
+
+    if (locked) {
+      sh.spill->check(sh.dir);
+      pthread_mutex_unlock(&sh.lock);
+    }
+  }
+}
+
+void dirFanout::cleanShard(
+  unsigned which
+) {
+  // Cleans the shard "which", as clean_files() would the directory
+
+  shard & sh = *_shards[which];
+
+  if (sh.spill->used()) {
+    if (! sh.spill->clean(_ctx, sh.dir, *_git)) {
+      pthread_mutex_lock(&_lock);
+      _failed = true;
+      pthread_mutex_unlock(&_lock);
+    }
+  } else {
+    clean_files(_ctx, sh.dir, *_git);
+  }
+}
+
+void dirFanout::dispatch()
+{
+  // Hands the entries gathered to the helpers, as a chunk; the scanner
+  // waits while there are twice as many chunks queued as helpers, and
+  // is marked stuck if a helper timed out.
+
+  if (_next.empty()) return;
+
+  chunk * pC = new chunk;
+  pC->swap(_next);
+
+  pthread_mutex_lock(&_lock);
+  while (_chunks.size() >= 2 * _helpers.size()  &&  ! _stuck) {
+    pthread_cond_wait(&_idle, &_lock);
+  }
+  _chunks.push_back(pC);
+  pthread_cond_signal(&_work);
+  bool stuck = _stuck;
+  pthread_mutex_unlock(&_lock);
+
+  if (stuck) fs_stick();
+}
+
+void dirFanout::wait()
+{
+  // Waits until the helpers have nothing left to do
+
+  pthread_mutex_lock(&_lock);
+  while (! _chunks.empty()  ||  ! _toClean.empty()  ||  _busy > 0) {
+    pthread_cond_wait(&_idle, &_lock);
+  }
+  pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,133 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef FANOUT_H_
+#define FANOUT_H_
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dircache.hh"          // Includes: map, string, vector, ...
+#include "file.hh"              // Includes: list, map, string, utility, ...
+#include "gitindex.hh"          // Includes: map, string, unordered_set
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+#include "sched.hh"             // Includes: list, string, vector, ...
+
+extern "C" {
+  #include <pthread.h>
+  #include <sys/types.h>
+}
+
+class dirSpill;
+class opThrottle;
+class runContext;
+
+// Parallel work on a single huge directory ("options::dirJobs").
+//
+// The scanner threads share the directories among them, which does
+// not help when most of the files are in a single one.  When a
+// directory has given more than "chunkSize" entries to be examined,
+// its scanner starts "options::dirJobs" helper threads, bound to the
+// same clean and throttle (see fsops.hh), and only reads it from then
+// on: the entries are handed to the helpers in chunks.  A helper
+// examines every entry of a chunk (stat, then the subdirectories and
+// the file families, as the scanner would), and merges the families
+// found into a table split in "nShards" shards by a hash of the
+// basename, each one with its own lock (and, under a memory cap, its
+// own spill, see spill.hh).  A family is then whole in a single shard:
+// once the directory has been read, the shards are cleaned by the
+// helpers in parallel.  The decisions are the same, in another order.
+//
+// "examine" is the function examining an entry (in cleandir.cxx), with
+// the entries found before the start in the currDir handed to
+// finish().
+
+typedef std::pair< ino_t, std::string > inodeEntry;
+
+typedef void (*entryFunction)(runContext &, const std::string &,
+                              const std::string &, currDir &, taskList &,
+                              ltx::dirCache::state *);
+
+class dirFanout {
+public:
+  static const std::vector<inodeEntry>::size_type chunkSize = 4096;
+
+private:
+  static const unsigned nShards = 64;
+
+  typedef std::vector<inodeEntry> chunk;
+
+  // A part of the family table
+
+  struct shard {
+    pthread_mutex_t lock;
+    currDir         dir;
+    dirSpill      * spill;
+
+    shard(const std::string &, const runContext &);
+    ~shard();
+  };
+
+  // A helper thread, and what it found
+
+  struct helper {
+    dirFanout          * owner;
+    pthread_t            id;
+    ltx::opCounters      counters;
+    taskList             subDirs;
+    ltx::dirCache::state seen;
+  };
+
+  runContext            & _ctx;
+  std::string             _name;
+  entryFunction           _examine;
+  opThrottle            * _throttle;
+  ltx::opCounters       * _counters;
+  bool                    _caching;
+
+  pthread_mutex_t         _lock;
+  pthread_cond_t          _work;          // Something to do for helpers,
+  pthread_cond_t          _idle;          //   a helper done with it.
+  std::deque<chunk *>     _chunks;
+  std::deque<unsigned>    _toClean;
+  unsigned                _busy;
+  bool                    _closing;
+  bool                    _stuck;
+  bool                    _failed;
+  const gitScope        * _git;
+
+  chunk                   _next;
+  std::vector<helper *>   _helpers;
+  std::vector<shard *>    _shards;
+
+  static void * body(void *);
+
+  void run(helper &);
+  void scan(helper &, chunk &);
+  void absorb(currDir &);
+  void cleanShard(unsigned);
+  void dispatch();
+  void wait();
+
+  dirFanout & operator = (const dirFanout & rhs);
+  dirFanout(const dirFanout & rhs);
+
+public:
+  dirFanout(runContext &, const std::string &, entryFunction);
+  ~dirFanout();
+
+  bool active() const { return ! _helpers.empty(); }
+
+  bool start(bool);
+  void add(ino_t, const std::string &);
+  void finish(currDir &, taskList &, ltx::dirCache::state *&);
+  bool clean(const gitScope &);
+};
+
+#endif // FANOUT_H_
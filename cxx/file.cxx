@@ -14,15 +14,15 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
-#include "file.hh"              // Includes: list, map, string, utility, ctime
+#include "file.hh"              // Includes: list, map, string, utility, ...
 
 using std::string;
 
 // Methods for the class fileFamily
 
 void fileFamily::addExtension(
-  time_t         mTime,
-  const string * pExtName
+  const fileTime & mTime,
+  const string   * pExtName
 ) {
   // Insert the file informations in a fileFamily.  "mTime" is the
   // modification time, "pExtName" points to the file extension or is
@@ -36,6 +36,15 @@ void fileFamily::addExtension(
   }
 }
 
+// Rough costs of the nodes held by a currDir, in bytes: a member of a
+// family (in the list of its extensions, or of the backups), and a
+// family (in the map, with its fileFamily).
+
+namespace {
+  const unsigned long fileCost   = 64;
+  const unsigned long familyCost = 144;
+}
+
 // Auxiliary function object for currDir objects
 
 struct releaseFileFamily
@@ -57,14 +66,33 @@ fileFamily & currDir::getFileFamily(
   // Gets the file family related to the basename "base".  If this is
   // the first file found, a fileFamily instance is allocated with
   // "operator new" (and will be later deleted in the currDir class
-  // destructor).
+  // destructor).  Every call is taken as adding a file to the family.
 
   fileFamily * retval = _dirContent[ base ];
 
   if (retval == 0) {
     retval              = new fileFamily;
     _dirContent[ base ] = retval;
+    _bytes             += familyCost + base.size();
   }
 
+  _bytes += fileCost;
   return *retval;
 }
+
+void currDir::addBackup(
+  const string & name
+) {
+  _backups.push_back(name);
+  _bytes += fileCost + name.size();
+}
+
+void currDir::clear()
+{
+  // Drops all the files held, keeping the directory name
+
+  for_each(_dirContent.begin(), _dirContent.end(), releaseFileFamily());
+  _dirContent.clear();
+  _backups.clear();
+  _bytes = 0;
+}
@@ -20,6 +20,10 @@
 #include <utility>
 #include <ctime>
 
+extern "C" {
+  #include <time.h>
+}
+
 // Classes for the handling of directories and files.
 //
 // - The files are abstracted as a basename, an extension and a
@@ -39,13 +43,29 @@
 //   existence of a .tex; to get its modification time; to add a
 //   member to the family; and to retrieve the list of all the
 //   extensions found.
+//
+// - The modification times are kept to the nanosecond, as given by
+//   the file system: a source and its outputs are often written within
+//   the same second by a fast build.
+
+struct fileTime {
+  time_t sec;
+  long   nsec;
+
+  fileTime(time_t s = 0, long n = 0) : sec(s), nsec(n) {}
+  explicit fileTime(const struct timespec & t)
+    : sec(t.tv_sec), nsec(t.tv_nsec) {}
 
-typedef std::pair< std::string, time_t > extInfo;
+  bool operator > (const fileTime & rhs) const {
+    return sec > rhs.sec  ||  (sec == rhs.sec  &&  nsec > rhs.nsec); }
+};
+
+typedef std::pair< std::string, fileTime > extInfo;
 
 class fileFamily {
 private:
   bool               _hasTex;
-  time_t             _texMtime;
+  fileTime           _texMtime;
   std::list<extInfo> _extInfo;
 
   // Prevents any use of the copy constructor and of the assignment
@@ -55,13 +75,13 @@ private:
   fileFamily(const fileFamily & rhs);
 
 public:
-  fileFamily() : _hasTex(false), _texMtime(0) {}
+  fileFamily() : _hasTex(false) {}
   ~fileFamily() {}
 
-  bool   hasTex()   const { return _hasTex;   }
-  time_t texMtime() const { return _texMtime; }
+  bool     hasTex()   const { return _hasTex;   }
+  fileTime texMtime() const { return _texMtime; }
 
-  void addExtension(time_t, const std::string *);
+  void addExtension(const fileTime &, const std::string *);
 
   // Const-iterators over all the found extensions
 
@@ -74,15 +94,19 @@ public:
 // A directory is seen as a directory name plus a collection of file
 // families; that collection is implemented as an STL map.  Methods
 // are provided to add a file, to retrieve the directory name, and to
-// iterate over the file families.
+// iterate over the file families.  The editor backup files found are
+// kept apart, in a list.  An estimate of the memory held is kept, to
+// bound it for huge directories (see spill.hh).
 
 typedef std::pair< const std::string, fileFamily * > fileCollectionElement;
 typedef std::map< const std::string, fileFamily * >  fileCollection;
 
 class currDir {
 private:
-  std::string    _name;
-  fileCollection _dirContent;
+  std::string            _name;
+  fileCollection         _dirContent;
+  std::list<std::string> _backups;
+  unsigned long          _bytes;
 
   // Prevents any use of the copy constructor and of the assignment
   // operator
@@ -91,7 +115,7 @@ private:
   currDir(const currDir & rhs);
 
 public:
-  currDir(const std::string & dirName) : _name(dirName) { }
+  currDir(const std::string & dirName) : _name(dirName), _bytes(0) { }
   ~currDir();
 
   const std::string & getName() const { return _name; }
@@ -103,6 +127,12 @@ public:
     return _dirContent.begin(); }
   fileCollection::const_iterator end() const {
     return _dirContent.end(); };
+
+  void addBackup(const std::string &);
+  const std::list<std::string> & backups() const { return _backups; }
+
+  unsigned long bytes() const { return _bytes; }
+  void          clear();
 };
 
 #endif // FILE_H_
@@ -0,0 +1,36 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef FNV_H_
+#define FNV_H_
+
+#include <string>
+
+// The FNV-1a hash (32 bits) of a string, continuing from "seed" (the
+// standard offset basis, if not given).  It is used wherever names
+// must hash to the same value on every host and in every run: the
+// shards of a sweep (cleandir.cxx), the anonymized names of a dump
+// (dump.cxx), the shards of a huge directory (fanout.cxx).
+
+const unsigned long fnvBasis = 2166136261UL;
+const unsigned long fnvPrime = 16777619UL;
+
+inline unsigned long fnv1a(
+  const std::string & s,
+  unsigned long       seed = fnvBasis
+) {
+  unsigned long h = seed & 0xffffffffUL;
+
+  for (std::string::const_iterator iter = s.begin();
+       iter != s.end();  iter++) {
+    h = ((h ^ static_cast<unsigned char>(*iter)) * fnvPrime) & 0xffffffffUL;
+  }
+  return h;
+}
+
+#endif // FNV_H_
@@ -0,0 +1,234 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include "fsbackend.hh"         // Includes: string, dirent.h, sys/stat.h
+
+extern "C" {
+  #include <fcntl.h>
+  #include <pthread.h>
+  #include <unistd.h>
+  #include <sys/sysmacros.h>
+}
+
+using std::string;
+
+// Local types
+
+namespace {
+  class posixDir : public ltx::fsDir {
+  private:
+    DIR * _pDir;
+
+  public:
+    explicit posixDir(DIR * p) : _pDir(p) {}
+    ~posixDir() { closedir(_pDir); }
+
+    struct dirent * next() { return readdir(_pDir); }
+  };
+
+  class posixBackend : public ltx::fsBackend {
+  public:
+    int          stat(const string &, struct stat *, unsigned);
+    int          remove(const string &);
+    ltx::fsDir * openDir(const string &);
+    int          prefetch(const string &);
+    int          readFile(const string &, string &);
+  };
+}
+
+// Local variables
+
+namespace {
+#if defined(STATX_TYPE)
+  pthread_once_t statxOnce = PTHREAD_ONCE_INIT;
+  bool           haveStatx = false;
+#endif // STATX_TYPE
+}
+
+// Local functions (declarations)
+
+namespace {
+#if defined(STATX_TYPE)
+  void probe_statx();
+#endif // STATX_TYPE
+}
+
+// Methods of the interface
+
+ltx::fsDir::~fsDir()
+{
+}
+
+ltx::fsBackend::~fsBackend()
+{
+}
+
+int ltx::fsBackend::prefetch(
+  const string &
+) {
+  return 0;
+}
+
+int ltx::fsBackend::readFile(
+  const string &,
+  string       &
+) {
+  errno = ENOSYS;
+  return -1;
+}
+
+ltx::fsBackend & ltx::posix_backend()
+{
+  static posixBackend backend;
+  return backend;
+}
+
+// Methods for the class posixBackend
+
+namespace {
+  int posixBackend::stat(
+    const string & name,
+    struct stat  * pStat,
+    unsigned       fields
+  ) {
+    // Where statx(2) is known, it is asked only for the fields needed:
+    // a network file system may then answer without fetching the
+    // others from the server (or, with "statNoSync", without any
+    // revalidation at all).  A kernel without statx gets stat(2),
+    // as found once for all the threads.
+
+#if defined(STATX_TYPE)
+    pthread_once(&statxOnce, probe_statx);
+
+    if (haveStatx) {
+      unsigned int mask  = STATX_TYPE | STATX_MODE | STATX_MTIME |
+                           STATX_INO;
+      int          flags = (fields & ltx::statNoSync) ?
+                           AT_STATX_DONT_SYNC : AT_STATX_SYNC_AS_STAT;
+      struct statx sx;
+
+      if (fields & ltx::statTimes) mask |= STATX_CTIME;
+      if (fields & ltx::statSize)  mask |= STATX_SIZE | STATX_BLOCKS |
+                                           STATX_NLINK;
+
+      // A field asked for may still not be given (the file system
+      // does not have it, or cannot tell it without the server):
+      // stat(2) is then called after all.
+
+      int rc = statx(AT_FDCWD, name.c_str(), flags, mask, &sx);
+
+      if (rc == 0  &&  (sx.stx_mask & mask) == mask) {
+        std::memset(pStat, 0, sizeof(*pStat));
+        pStat->st_dev          = makedev(sx.stx_dev_major, sx.stx_dev_minor);
+        pStat->st_ino          = sx.stx_ino;
+        pStat->st_mode         = sx.stx_mode;
+        pStat->st_nlink        = sx.stx_nlink;
+        pStat->st_size         = sx.stx_size;
+        pStat->st_blocks       = sx.stx_blocks;
+        pStat->st_mtim.tv_sec  = sx.stx_mtime.tv_sec;
+        pStat->st_mtim.tv_nsec = sx.stx_mtime.tv_nsec;
+        pStat->st_ctim.tv_sec  = sx.stx_ctime.tv_sec;
+        pStat->st_ctim.tv_nsec = sx.stx_ctime.tv_nsec;
+        return 0;
+      }
+      if (rc != 0) return -1;
+    }
+#endif // STATX_TYPE
+
+    return ::stat(name.c_str(), pStat);
+  }
+
+  int posixBackend::remove(
+    const string & name
+  ) {
+    return std::remove(name.c_str());
+  }
+
+  ltx::fsDir * posixBackend::openDir(
+    const string & name
+  ) {
+    DIR * pDir = opendir(name.c_str());
+    return pDir ? new posixDir(pDir) : 0;
+  }
+
+  int posixBackend::prefetch(
+    const string & name
+  ) {
+    // Opens the directory "name", tells the kernel that its blocks
+    // will be needed, and reads all of it (so that the file system
+    // fetches the entries, and their attributes where it can).
+
+    int fd = open(name.c_str(), O_RDONLY | O_DIRECTORY | O_NONBLOCK);
+    if (fd < 0) return -1;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+    DIR * pDir = fdopendir(fd);
+    if (pDir == 0) {
+      close(fd);
+      return -1;
+    }
+    while (readdir(pDir) != 0) ;
+    closedir(pDir);
+    return 0;
+  }
+
+  int posixBackend::readFile(
+    const string & name,
+    string       & content
+  ) {
+    // Reads the file "name" through, in chunks; its size, when known,
+    // is only a hint.
+
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat sStat;
+    char        buffer[65536];
+    ssize_t     n;
+
+    content.clear();
+    if (fstat(fd, &sStat) == 0  &&  sStat.st_size > 0) {
+      content.reserve(sStat.st_size);
+    }
+
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+      if (n < 0) {
+        if (errno == EINTR) continue;
+
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+      }
+      content.append(buffer, n);
+    }
+
+    close(fd);
+    return 0;
+  }
+}
+
+// Local functions (definitions)
+
+namespace {
+#if defined(STATX_TYPE)
+  void probe_statx()
+  {
+    // Tells whether the kernel knows statx(2)
+
+    struct statx sx;
+
+    haveStatx = statx(AT_FDCWD, "/", AT_STATX_SYNC_AS_STAT, STATX_TYPE,
+                      &sx) == 0  ||  errno != ENOSYS;
+  }
+#endif // STATX_TYPE
+}
@@ -0,0 +1,70 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef FSBACKEND_H_
+#define FSBACKEND_H_
+
+#include <string>
+
+extern "C" {
+  #include <dirent.h>
+  #include <sys/stat.h>
+}
+
+// The file system seen by the scanner ("options::backend").
+//
+// Every metadata operation of the engine (see fsops.hh) ends up in a
+// backend: listing a directory, stat, removing a file, prefetching a
+// directory; so do the reads of the few files whose content matters
+// (the index of a git repository and its companions, see gitindex.hh).
+// The default one, posix_backend(), calls the C library; others may
+// simulate a file system (see memfs.hh), so that the cost of the
+// engine can be measured apart from that of the kernel.
+//
+// The methods follow the conventions of the C library: -1 (or a null
+// pointer) and errno on errors.  stat() is told which fields are
+// needed, as a combination of "statFields": the file type, mode,
+// modification time, device and inode numbers always; the others may
+// be left to zero, if not asked for.  readFile() gives the whole
+// content of a file; by default it fails with ENOSYS (then, no git
+// index can be read, and nothing is removed from a work tree).  A
+// backend is used by all the scanner threads at once, and by the
+// runner threads of fsops too.
+
+namespace ltx {
+
+  enum statFields {
+    statBasic  = 0,             // Type, mode, mtime, device and inode;
+    statTimes  = 1,             // the change time too;
+    statSize   = 2,             // size, blocks and links too;
+    statNoSync = 4              // don't revalidate network attributes.
+  };
+
+  // A directory being listed; deleting it closes it
+
+  class fsDir {
+  public:
+    virtual ~fsDir();
+    virtual struct dirent * next() = 0;
+  };
+
+  class fsBackend {
+  public:
+    virtual ~fsBackend();
+
+    virtual int     stat(const std::string &, struct stat *, unsigned) = 0;
+    virtual int     remove(const std::string &) = 0;
+    virtual fsDir * openDir(const std::string &) = 0;
+    virtual int     prefetch(const std::string &);
+    virtual int     readFile(const std::string &, std::string &);
+  };
+
+  fsBackend & posix_backend();
+}
+
+#endif // FSBACKEND_H_
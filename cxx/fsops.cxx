@@ -0,0 +1,480 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <cerrno>
+#include <cstdio>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "fsbackend.hh"         // Includes: string, dirent.h, sys/stat.h
+#include "throttle.hh"          // Includes: pthread.h
+
+extern "C" {
+  #include <time.h>
+}
+
+using std::string;
+using ltx::opCounters;
+using ltx::fsDir;
+
+// Local types, variables and functions
+
+namespace {
+  // An operation, as executed (possibly) by a runner thread, on the
+  // backend of the clean of the calling thread
+
+  struct fsJob {
+    enum opCode { opStat, opRemove, opOpen, opRead, opPrefetch,
+                  opReadFile };
+
+    opCode                     op;
+    string                     name;
+    ltx::fsBackend           * fs;
+    fsDir                    * pDir;
+    std::vector<struct dirent> batch;
+    string                     content;
+    struct stat                sStat;
+    unsigned                   fields;
+    int                        rc;
+    int                        err;
+    bool                       done;
+
+    fsJob(opCode o, const string & n, fsDir * p = 0);
+  };
+
+  // A runner thread, and the single job it is running.  When its
+  // owner gives up waiting (or exits), "abandoned" is set: the runner
+  // disposes of the job (if any) and of itself, then exits.
+
+  struct runner {
+    pthread_mutex_t   lock;
+    pthread_cond_t    cond;
+    fsJob           * pJob;
+    bool              abandoned;
+  };
+
+  // Everything fsops knows about a thread
+
+  struct threadState {
+    runContext * pContext;
+    opThrottle * pThrottle;
+    opCounters * pCounters;
+    opCounters   unbound;       // Used, but never read, if not bound
+    runner     * pRunner;
+    bool         stuck;
+  };
+
+  pthread_key_t  stateKey;
+  pthread_once_t stateOnce = PTHREAD_ONCE_INIT;
+
+  void release_state(void *);
+  void create_key();
+
+  threadState & state()
+  {
+    pthread_once(&stateOnce, create_key);
+
+    threadState * pS =
+      static_cast<threadState *>(pthread_getspecific(stateKey));
+
+    if (pS == 0) {
+      pS = new threadState;
+      pS->pContext  = 0;
+      pS->pThrottle = 0;
+      pS->pCounters = 0;
+      pS->pRunner   = 0;
+      pS->stuck     = false;
+      pthread_setspecific(stateKey, pS);
+    }
+    return *pS;
+  }
+
+  opCounters & counters()
+  {
+    threadState & s = state();
+    return s.pCounters ? *s.pCounters : s.unbound;
+  }
+
+  fsJob::fsJob(
+    opCode         o,
+    const string & n,
+    fsDir        * p
+  ) : op(o), name(n), pDir(p), fields(ltx::statBasic), rc(0), err(0),
+      done(false)
+  {
+    const runContext * pC = state().pContext;
+    fs = pC  &&  pC->opts.backend ? pC->opts.backend : &ltx::posix_backend();
+    if (pC  &&  pC->opts.noSync) fields |= ltx::statNoSync;
+  }
+
+  void execute(
+    fsJob & j
+  ) {
+    errno = 0;
+
+    switch (j.op) {
+      case fsJob::opStat:
+        j.rc = j.fs->stat(j.name, &j.sStat, j.fields);
+        break;
+
+      case fsJob::opRemove:
+        j.rc = j.fs->remove(j.name);
+        break;
+
+      case fsJob::opOpen:
+        j.pDir = j.fs->openDir(j.name);
+        j.rc   = j.pDir ? 0 : -1;
+        break;
+
+      case fsJob::opPrefetch:
+        j.rc = j.fs->prefetch(j.name);
+        break;
+
+      case fsJob::opReadFile:
+        j.rc = j.fs->readFile(j.name, j.content);
+        break;
+
+      case fsJob::opRead:
+        {
+          struct dirent * pDe;
+          j.rc = 0;
+          while (j.batch.size() < dirReader::entriesPerOp  &&
+                 (pDe = j.pDir->next()) != 0) {
+            j.batch.push_back(*pDe);
+          }
+        }
+        break;
+    }
+    j.err = errno;
+  }
+
+  void * run(
+    void * arg
+  ) {
+    // Body of a runner thread
+
+    runner & r = *static_cast<runner *>(arg);
+
+    pthread_mutex_lock(&r.lock);
+
+    for (;;) {
+      while ((r.pJob == 0  ||  r.pJob->done)  &&  ! r.abandoned) {
+        pthread_cond_wait(&r.cond, &r.lock);
+      }
+      if (r.pJob == 0  ||  r.pJob->done) break;
+
+      fsJob * pJ = r.pJob;
+      pthread_mutex_unlock(&r.lock);
+      execute(*pJ);
+      pthread_mutex_lock(&r.lock);
+
+      pJ->done = true;
+      pthread_cond_signal(&r.cond);
+
+      if (r.abandoned) {
+
+        // Nobody is interested any more in this directory: closes it.
+
+        delete pJ->pDir;
+        delete pJ;
+        r.pJob = 0;
+        break;
+      }
+    }
+
+    pthread_mutex_unlock(&r.lock);
+    pthread_cond_destroy(&r.cond);
+    pthread_mutex_destroy(&r.lock);
+    delete &r;
+    return 0;
+  }
+
+  runner * start_runner()
+  {
+    runner * pR = new runner;
+    pthread_mutex_init(&pR->lock, 0);
+    pR->pJob      = 0;
+    pR->abandoned = false;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pR->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t tid;
+    pthread_create(&tid, 0, run, pR);
+    pthread_detach(tid);
+    return pR;
+  }
+
+  void abandon(
+    runner * pR
+  ) {
+    // Must be called with the runner lock held
+
+    pR->abandoned = true;
+    pthread_cond_signal(&pR->cond);
+    pthread_mutex_unlock(&pR->lock);
+  }
+
+  void release_state(
+    void * p
+  ) {
+    threadState * pS = static_cast<threadState *>(p);
+
+    if (pS->pRunner) {
+      pthread_mutex_lock(&pS->pRunner->lock);
+      abandon(pS->pRunner);
+    }
+    delete pS;
+  }
+
+  void create_key()
+  {
+    pthread_key_create(&stateKey, release_state);
+  }
+
+  const char * opName(
+    fsJob::opCode op
+  ) {
+    switch (op) {
+      case fsJob::opStat:     return "stat";
+      case fsJob::opRemove:   return "remove";
+      case fsJob::opOpen:     return "opendir";
+      case fsJob::opRead:     return "readdir";
+      case fsJob::opPrefetch: return "prefetch";
+      case fsJob::opReadFile: return "read";
+    }
+    return "?";
+  }
+
+  bool perform(
+    fsJob & j
+  ) {
+    // Performs the operation "j", under the control of the throttle of
+    // the calling thread; and, if a timeout has been set, by means of
+    // a runner thread.  Returns false if the operation has been given
+    // up: in that case, the ownership of any directory stream in "j"
+    // passes to the runner.
+
+    threadState & s       = state();
+    double        timeout = s.pContext ? s.pContext->opts.opTimeout : 0.0;
+    opGuard       g(s.pThrottle);
+
+    if (timeout <= 0.0) {
+      execute(j);
+      return true;
+    }
+
+    if (s.pRunner == 0) s.pRunner = start_runner();
+
+    runner & r   = *s.pRunner;
+    fsJob  * pJ  = new fsJob(j);
+    int      err = 0;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec  += static_cast<time_t>(timeout);
+    deadline.tv_nsec += static_cast<long>(
+      (timeout - static_cast<time_t>(timeout)) * 1e9);
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&r.lock);
+    r.pJob = pJ;
+    pthread_cond_signal(&r.cond);
+
+    while (! pJ->done  &&  err != ETIMEDOUT) {
+      err = pthread_cond_timedwait(&r.cond, &r.lock, &deadline);
+    }
+
+    if (pJ->done) {
+      r.pJob = 0;
+      pthread_mutex_unlock(&r.lock);
+      j.pDir = pJ->pDir;
+      j.batch.swap(pJ->batch);
+      j.content.swap(pJ->content);
+      j.sStat = pJ->sStat;
+      j.rc    = pJ->rc;
+      j.err   = pJ->err;
+      delete pJ;
+      return true;
+    }
+
+    abandon(&r);
+    s.pRunner = 0;
+    s.stuck   = true;
+    counters().timeouts++;
+
+    s.pContext->timedOut(string(opName(j.op)) + " " + j.name);
+
+    j.rc  = -1;
+    j.err = ETIMEDOUT;
+    return false;
+  }
+}
+
+void fsops_bind(
+  runContext * pContext,
+  opThrottle * pThrottle,
+  opCounters * pCounters
+) {
+  threadState & s = state();
+  s.pContext  = pContext;
+  s.pThrottle = pThrottle;
+  s.pCounters = pCounters;
+}
+
+void fsops_bound(
+  runContext  *& pContext,
+  opThrottle  *& pThrottle,
+  opCounters  *& pCounters
+) {
+  threadState & s = state();
+  pContext  = s.pContext;
+  pThrottle = s.pThrottle;
+  pCounters = s.pCounters;
+}
+
+bool fs_stuck()
+{
+  return state().stuck;
+}
+
+void fs_stick()
+{
+  state().stuck = true;
+}
+
+void fs_unstick()
+{
+  state().stuck = false;
+}
+
+int fs_stat(
+  const string & name,
+  struct stat  * pStat,
+  unsigned       fields
+) {
+  fsJob j(fsJob::opStat, name);
+  j.fields |= fields;
+  perform(j);
+
+  opCounters & c = counters();
+  c.stats++;
+  if (j.rc != 0) c.errors++;
+  else           *pStat = j.sStat;
+
+  errno = j.err;
+  return j.rc;
+}
+
+int fs_remove(
+  const string & name
+) {
+  fsJob j(fsJob::opRemove, name);
+  perform(j);
+
+  opCounters & c = counters();
+  if (j.rc == 0) c.removed++;
+  else           c.errors++;
+
+  errno = j.err;
+  return j.rc;
+}
+
+int fs_prefetch(
+  const string & name
+) {
+  fsJob j(fsJob::opPrefetch, name);
+  perform(j);
+
+  errno = j.err;
+  return j.rc;
+}
+
+int fs_read(
+  const string & name,
+  string       & content
+) {
+  fsJob j(fsJob::opReadFile, name);
+  perform(j);
+
+  if (j.rc == 0) content.swap(j.content);
+
+  errno = j.err;
+  return j.rc;
+}
+
+// Methods for the class dirReader
+
+dirReader::dirReader(
+  const string & name
+) : _pDir(0), _nRead(0), _name(name), _next(0), _eof(false)
+{
+  const runContext * pC = state().pContext;
+  fsJob              j(fsJob::opOpen, name);
+
+  _batched = pC  &&  pC->opts.opTimeout > 0.0;
+
+  if (perform(j)) _pDir = j.pDir;
+
+  opCounters & c = counters();
+  if (_pDir) c.dirs++;
+  else       c.errors++;
+}
+
+dirReader::~dirReader()
+{
+  delete _pDir;
+}
+
+struct dirent * dirReader::next()
+{
+  // Returns the next directory entry, or a null pointer at the end of
+  // the directory.  Every "entriesPerOp" entries, the read is
+  // accounted as a new operation.
+  //
+  // If a timeout has been set, the entries are read by the runner in
+  // batches of "entriesPerOp", each one subject to the timeout; if a
+  // batch times out, the stream belongs now to the runner and is
+  // forgotten.
+
+  struct dirent * pDe;
+
+  if (_pDir == 0) return 0;
+
+  if (_batched) {
+    if (_next == _batch.size()) {
+      if (_eof) return 0;
+
+      fsJob j(fsJob::opRead, _name, _pDir);
+      if (! perform(j)) {
+        _pDir = 0;
+        return 0;
+      }
+      _batch.swap(j.batch);
+      _next = 0;
+      _eof  = _batch.size() < entriesPerOp;
+      if (_batch.empty()) return 0;
+    }
+    pDe = &_batch[_next++];
+
+  } else if (++_nRead % entriesPerOp == 0) {
+    opGuard g(state().pThrottle);
+    pDe = _pDir->next();
+
+  } else {
+    pDe = _pDir->next();
+  }
+
+  if (pDe) counters().entries++;
+  return pDe;
+}
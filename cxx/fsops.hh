@@ -0,0 +1,103 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef FSOPS_H_
+#define FSOPS_H_
+
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include <dirent.h>
+  #include <sys/stat.h>
+  #include <sys/types.h>
+}
+
+#include "fsbackend.hh"         // Includes: string, dirent.h, sys/stat.h
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+
+class opThrottle;
+class runContext;
+
+// Wrappers around the metadata operations issued by the scanner.
+//
+// Every scanner thread works on behalf of a clean and of a device (see
+// sched.hh): fsops_bind() ties the calling thread to the context of
+// the clean, to the throttle and to the counters it must use;
+// operations issued by a thread not bound to any device are neither
+// throttled nor counted.
+//
+// The operations are carried out by the backend given in the options
+// of the clean (see fsbackend.hh), the C library by default.  fs_stat()
+// asks only for the basic fields, unless told otherwise, and not to
+// revalidate the attributes if "options::noSync" is set.
+//
+// Directories are read through the class "dirReader"; since the
+// entries are buffered by the C library, a directory listing is
+// accounted as one operation when it is opened plus one operation for
+// every "entriesPerOp" entries read (which, with a timeout, are read
+// in a single batch).
+//
+// fs_prefetch() warms the caches for a directory that will be scanned
+// soon: it opens it, advises the kernel that its content will be
+// needed and reads it through; it is accounted as a single operation.
+// fs_read() reads a whole file (see gitindex.hh), as a single operation
+// too; neither is counted.
+//
+// If "options::opTimeout" is positive, every operation is handed to a
+// runner thread dedicated to the calling thread, and is given up if
+// not completed within that many seconds: the call fails with errno
+// set to ETIMEDOUT, the runner is left behind (a system call cannot
+// be interrupted) and a new one will be started for the next
+// operation.  A timed out operation marks the calling thread as
+// "stuck" until fs_unstick() is called, so that the scanner may
+// abandon the current directory; the operation is also recorded in
+// the context of the clean, for the final summary.
+//
+// fsops_bound() tells how the calling thread is bound, so that helper
+// threads working on its behalf (see fanout.hh) may be bound to the
+// same clean and throttle, with counters of their own; fs_stick()
+// marks the calling thread as stuck when one of its helpers was.
+
+void fsops_bind(runContext *, opThrottle *, ltx::opCounters *);
+void fsops_bound(runContext *&, opThrottle *&, ltx::opCounters *&);
+
+bool fs_stuck();
+void fs_stick();
+void fs_unstick();
+
+int fs_stat(const std::string &, struct stat *,
+            unsigned = ltx::statBasic);
+int fs_remove(const std::string &);
+int fs_prefetch(const std::string &);
+int fs_read(const std::string &, std::string &);
+
+class dirReader {
+private:
+  ltx::fsDir                 * _pDir;
+  unsigned long                _nRead;
+  std::string                  _name;
+  std::vector<struct dirent>   _batch;
+  std::vector<struct dirent>::size_type _next;
+  bool                         _eof;
+  bool                         _batched;
+
+  dirReader & operator = (const dirReader & rhs);
+  dirReader(const dirReader & rhs);
+
+public:
+  static const unsigned long entriesPerOp = 512;
+
+  dirReader(const std::string &);
+  ~dirReader();
+
+  bool            isOpen() const { return _pDir != 0; }
+  struct dirent * next();
+};
+
+#endif // FSOPS_H_
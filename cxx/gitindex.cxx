@@ -0,0 +1,391 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <sstream>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "gitindex.hh"          // Includes: map, string, unordered_set
+
+extern "C" {
+  #include <sys/stat.h>
+}
+
+using std::string;
+
+// Local variables
+
+namespace {
+  const size_t sha1Size    = 20;      // Object names, in bytes
+  const size_t sha256Size  = 32;
+  const size_t statSize    = 40;      // ctime ... size, in an entry
+  const unsigned extended  = 0x4000;  // Entry flag: more flags follow
+}
+
+// Local functions (declarations)
+
+namespace {
+  unsigned long get32(const unsigned char *);
+  unsigned      get16(const unsigned char *);
+  string        git_dir(const string &);
+  size_t        hash_size(const string &);
+  bool          first_line(const string &, string &);
+}
+
+// Methods for the class gitIndex
+
+bool gitIndex::load(
+  const string & workTree
+) {
+  // Reads the index of the repository whose work tree is "workTree"
+  // (empty or ending with "/"); returns false (and the index is not
+  // readable) if it cannot be read.  A missing index tracks nothing.
+  // All the files are read through fsops, so that a hung file system
+  // costs at most the timeout of the operations.
+
+  _gitDir = git_dir(workTree);
+  if (_gitDir.empty()) return false;
+
+  _hashSize = hash_size(_gitDir);
+  if (_hashSize == 0) return false;
+
+  string content;
+
+  if (fs_read(_gitDir + "/index", content) != 0) {
+    _readable = errno == ENOENT;
+  } else {
+    _readable = parse(content, false);
+  }
+
+  if (! _readable) _paths.clear();
+  return _readable;
+}
+
+bool gitIndex::read(
+  const string & name,
+  bool           shared
+) {
+  // Reads the index file "name", and parses it ("shared" if it is
+  // the shared index of a split one).
+
+  string content;
+  return fs_read(name, content) == 0  &&  parse(content, shared);
+}
+
+bool gitIndex::parse(
+  const string & content,
+  bool           shared
+) {
+  // The header is "DIRC", the version and the number of entries (all
+  // big-endian); the entries follow, then the extensions, then the
+  // checksum of the file.
+
+  const unsigned char * p    =
+    reinterpret_cast<const unsigned char *>(content.data());
+  size_t                size = content.size();
+  const unsigned char * end  = p + size;
+
+  if (size < 12 + _hashSize  ||  std::memcmp(p, "DIRC", 4) != 0) {
+    return false;
+  }
+  end -= _hashSize;
+
+  unsigned long version  = get32(p + 4);
+  unsigned long nEntries = get32(p + 8);
+
+  if (version < 2  ||  version > 4) return false;
+
+  const unsigned char * q = p + 12;
+  string                path;
+
+  for (unsigned long i = 0;  i < nEntries;  i++) {
+    const unsigned char * entry = q;
+
+    if (end - q < static_cast<long>(statSize + _hashSize + 2)) return false;
+    q += statSize + _hashSize;
+
+    unsigned flags = get16(q);
+    q += 2;
+
+    if (flags & extended) {
+      if (version < 3  ||  end - q < 2) return false;
+      q += 2;
+    }
+
+    // Version 4: the path is given as the number of characters to be
+    // dropped from the end of the previous one (a variable length
+    // integer, as in the git pack files), plus the characters to be
+    // appended; no padding.
+
+    if (version == 4) {
+      if (q >= end) return false;
+
+      unsigned long drop = *q & 0x7f;
+      while (*q++ & 0x80) {
+        if (q >= end  ||  drop > (ULONG_MAX >> 8)) return false;
+        drop = ((drop + 1) << 7) | (*q & 0x7f);
+      }
+
+      if (drop > path.size()) return false;
+      path.erase(path.size() - drop);
+    } else {
+      path.clear();
+    }
+
+    const unsigned char * nul =
+      static_cast<const unsigned char *>(std::memchr(q, 0, end - q));
+    if (nul == 0) return false;
+
+    path.append(reinterpret_cast<const char *>(q), nul - q);
+    q = nul + 1;
+
+    // Versions 2 and 3: the entry is padded with 1 to 8 NULs, up to a
+    // multiple of 8 bytes.
+
+    if (version < 4) {
+      size_t length = (nul - entry + 8) & ~static_cast<size_t>(7);
+      if (static_cast<size_t>(end - entry) < length) return false;
+      q = entry + length;
+    }
+
+    // In a split index, the entries replacing those of the shared
+    // index have no path: the one in the shared index stands.
+
+    if (! path.empty()) _paths.insert(path);
+  }
+
+  // The extensions: a signature, the size of the data, the data.  Those
+  // whose signature begins with an uppercase letter are optional; of
+  // the others, "link" (a split index) names the shared index, whose
+  // paths are tracked too (those it marks as deleted are kept all the
+  // same), and any other ("sdir", a sparse index) cannot be handled.
+
+  while (q < end) {
+    if (end - q < 8) return false;
+
+    const unsigned char * sign   = q;
+    unsigned long         length = get32(q + 4);
+
+    q += 8;
+    if (static_cast<unsigned long>(end - q) < length) return false;
+
+    if (std::memcmp(sign, "link", 4) == 0) {
+      if (shared  ||  length < _hashSize) return false;
+
+      static const char digits[] = "0123456789abcdef";
+      string            hex;
+      bool              none = true;
+
+      for (size_t i = 0;  i < _hashSize;  i++) {
+        hex += digits[q[i] >> 4];
+        hex += digits[q[i] & 0xf];
+        if (q[i] != 0) none = false;
+      }
+
+      if (! none  &&  ! read(_gitDir + "/sharedindex." + hex, true)) {
+        return false;
+      }
+
+    } else if (sign[0] < 'A'  ||  sign[0] > 'Z') {
+      return false;
+    }
+
+    q += length;
+  }
+
+  return true;
+}
+
+// Methods for the class repoFinder
+
+const gitScope & repoFinder::find(
+  runContext   & ctx,
+  const string & dir
+) {
+  // Finds the scope of "dir" (empty or ending with "/"): the one of a
+  // repository if it holds a ".git", else the one of its parent, one
+  // level down.  The parent is found on the path as given if possible,
+  // on the canonical path otherwise.
+
+  std::map<string, gitScope>::iterator where = _memo.find(dir);
+  if (where != _memo.end()) return where->second;
+
+  string      d = dir.empty() ? "./" : dir;
+  struct stat sStat;
+  gitScope    scope;
+
+  if (fs_stat(d + ".git", &sStat) == 0) {
+    if (fs_stat(d, &sStat) == 0) {
+      scope = gitScope(ctx.gitIndexFor(sStat.st_dev, sStat.st_ino, d), "");
+    }
+
+  } else if (d != "/") {
+    string            path  = d.substr(0, d.size() - 1);
+    string::size_type slash = path.rfind('/');
+    string            last  = path.substr(slash + 1);
+
+    if (slash == string::npos  ||  last == "."  ||  last == ".."  ||
+        last.empty()) {
+      char resolved[PATH_MAX];
+
+      if (realpath(d.c_str(), resolved) != 0  &&
+          string(resolved) != "/") {
+        path  = resolved;
+        slash = path.rfind('/');
+        last  = path.substr(slash + 1);
+        scope = find(ctx, path.substr(0, slash + 1)).below(last);
+      }
+
+    } else {
+      scope = find(ctx, path.substr(0, slash + 1)).below(last);
+    }
+  }
+
+  return _memo[dir] = scope;
+}
+
+namespace {
+  unsigned long get32(
+    const unsigned char * p
+  ) {
+    return (static_cast<unsigned long>(p[0]) << 24) |
+           (static_cast<unsigned long>(p[1]) << 16) |
+           (static_cast<unsigned long>(p[2]) <<  8) | p[3];
+  }
+
+  unsigned get16(
+    const unsigned char * p
+  ) {
+    return (p[0] << 8) | p[1];
+  }
+
+  string git_dir(
+    const string & workTree
+  ) {
+    // The git directory is ".git"; if ".git" is a file, it holds the
+    // line "gitdir: <path>", the path being relative to the work tree
+    // if not absolute.
+
+    string      git = workTree + ".git";
+    struct stat sStat;
+
+    if (fs_stat(git, &sStat) != 0) return "";
+    if (S_ISDIR(sStat.st_mode)) return git;
+
+    string line;
+    if (! first_line(git, line)  ||  line.compare(0, 8, "gitdir: ") != 0) {
+      return "";
+    }
+
+    string gitDir = line.substr(8);
+    if (gitDir.empty()) return "";
+    if (gitDir[0] != '/') gitDir = workTree + gitDir;
+
+    if (fs_stat(gitDir, &sStat) != 0  ||  ! S_ISDIR(sStat.st_mode)) {
+      return "";
+    }
+    return gitDir;
+  }
+
+  size_t hash_size(
+    const string & gitDir
+  ) {
+    // The size of the object names, from "extensions.objectformat" in
+    // the configuration of the repository (that of the main work tree,
+    // given in "commondir" for the others); 0 if unknown, or if either
+    // file exists but cannot be read.
+
+    string common;
+
+    if (! first_line(gitDir + "/commondir", common)) return 0;
+
+    if (common.empty()) {
+      common = gitDir;
+    } else if (common[0] != '/') {
+      common = gitDir + "/" + common;
+    }
+
+    string config;
+
+    if (fs_read(common + "/config", config) != 0  &&  errno != ENOENT) {
+      return 0;
+    }
+
+    std::istringstream in(config);
+    string             line, section;
+    size_t             size = sha1Size;
+
+    while (std::getline(in, line)) {
+      string::size_type first = line.find_first_not_of(" \t");
+      if (first == string::npos) continue;
+
+      if (line[first] == '[') {
+        string::size_type last = line.find(']', first);
+        section = line.substr(first + 1, last == string::npos ?
+                                         string::npos : last - first - 1);
+        for (string::iterator iter = section.begin();
+             iter != section.end();  iter++) {
+          *iter = std::tolower(static_cast<unsigned char>(*iter));
+        }
+        continue;
+      }
+
+      if (section != "extensions") continue;
+
+      // A line "key = value": blanks and case are not significant,
+      // and the value may be quoted.
+
+      string key, value;
+      bool   inValue = false;
+
+      for (string::size_type i = first;  i < line.size();  i++) {
+        char c = std::tolower(static_cast<unsigned char>(line[i]));
+
+        if (c == '#'  ||  c == ';') break;
+        if (c == ' '  ||  c == '\t'  ||  c == '"'  ||  c == '\r') continue;
+        if (c == '='  &&  ! inValue) {
+          inValue = true;
+        } else {
+          (inValue ? value : key) += c;
+        }
+      }
+
+      if (key == "objectformat") {
+        size = value == "sha1"   ? sha1Size   :
+               value == "sha256" ? sha256Size : 0;
+      }
+    }
+
+    return size;
+  }
+
+  bool first_line(
+    const string & name,
+    string       & line
+  ) {
+    // Puts in "line" the first line of the file "name", without
+    // trailing blanks (empty if there is no such file); false if the
+    // file exists but cannot be read.
+
+    string content;
+
+    line.clear();
+    if (fs_read(name, content) != 0) return errno == ENOENT;
+
+    line = content.substr(0, content.find('\n'));
+    while (! line.empty()  &&  (line[line.size()-1] == '\r'  ||
+                                line[line.size()-1] == ' ')) {
+      line.erase(line.size() - 1);
+    }
+    return true;
+  }
+}
@@ -0,0 +1,94 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef GITINDEX_H_
+#define GITINDEX_H_
+
+#include <map>
+#include <string>
+#include <tr1/unordered_set>
+
+class runContext;
+
+// Protection of the files tracked by git.
+//
+// Some repositories commit files that look like LaTeX byproducts (a
+// .pdf, a .bbl): these must never be removed.  When the scanner finds
+// a ".git" in a directory (a directory, or a file "gitdir: <path>" for
+// work trees and submodules), it reads the index of that repository
+// directly: the file is read in memory, and the paths of all its
+// entries (versions 2 and 3, with plain paths, and version 4, with
+// prefix compressed paths) are put in a hash set.  A file is then
+// tracked if its path, relative to the top of the work tree, is in
+// the set: one lookup per file about to be removed, and no process
+// spawned.  The size of the object names is taken from the setting
+// "extensions.objectformat" (SHA-1 or SHA-256); a split index (see
+// git-update-index(1)) is read together with its shared index, all the
+// paths of both being taken as tracked.
+//
+// All these files are read through fsops (see fsops.hh), on the
+// backend of the clean and within the timeout of the operations; the
+// index of a work tree is loaded once, by the first thread reaching
+// it, while the others wait for it (see context.hh).
+//
+// If the index of a repository cannot be read (or holds a sparse index,
+// whose directories hide the files they hold), nothing in its work
+// tree is removed: every candidate there is reported as skipped.  A
+// repository without an index (nothing ever added) tracks no file.
+//
+// A "gitScope" tells the index governing a directory (none if null)
+// and the path of the directory relative to the top of the work tree
+// ("" or ending with "/"); it is passed down the tree, and switched
+// when a nested repository is met.  A "repoFinder" finds the scope of
+// a directory given by its path, looking for a ".git" in it and in
+// its ancestors; it memoizes what it finds, so that every directory
+// is examined once.
+
+class gitIndex {
+private:
+  std::tr1::unordered_set<std::string> _paths;
+  std::string                          _gitDir;
+  size_t                               _hashSize;
+  bool                                 _readable;
+
+  bool read(const std::string &, bool);
+  bool parse(const std::string &, bool);
+
+public:
+  gitIndex() : _hashSize(0), _readable(false) {}
+
+  bool load(const std::string &);
+  bool readable() const { return _readable; }
+  bool tracked(const std::string & path) const {
+    return _paths.find(path) != _paths.end(); }
+  size_t size() const { return _paths.size(); }
+};
+
+struct gitScope {
+  const gitIndex * index;
+  std::string      prefix;
+
+  gitScope() : index(0) {}
+  gitScope(const gitIndex * i, const std::string & p) : index(i), prefix(p) {}
+
+  gitScope below(const std::string & name) const {
+    return index ? gitScope(index, prefix + name + "/") : gitScope(); }
+  bool tracked(const std::string & name) const {
+    return index  &&  index->tracked(prefix + name); }
+  bool unreadable() const { return index  &&  ! index->readable(); }
+};
+
+class repoFinder {
+private:
+  std::map<std::string, gitScope> _memo;
+
+public:
+  const gitScope & find(runContext &, const std::string &);
+};
+
+#endif // GITINDEX_H_
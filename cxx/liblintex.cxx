@@ -0,0 +1,299 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <cstdlib>
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "cleandir.hh"          // Includes: iosfwd, list, string, ...
+#include "gitindex.hh"          // Includes: map, string, unordered_set
+#include "locatedb.hh"          // Includes: list, string
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "prune.hh"             // Includes: bitset, string, vector
+
+extern "C" {
+  #include <limits.h>
+}
+
+using std::string;
+using ltx::decision;
+
+// Local functions (declarations)
+
+namespace {
+  void finish(runContext &, ltx::summary &);
+}
+
+// Methods for the classes of the interface
+
+ltx::options::options()
+  : trailEd("~"), confirm(false), recurse(false), pretend(false),
+    jobs(1), maxOpsPerSec(0.0), adaptive(false), targetLatency(0.0),
+    opTimeout(0.0), inodeOrder(false), prefetch(0), locateDb(),
+    exclude(), xdev(false), config(), recorder(false), git(true),
+    reclaim(0.0), measure(false), checkpoint(), checkpointEvery(60.0),
+    resume(false), shard(0), shards(1), shardDepth(1),
+    cache(0), backend(0), noSync(false), maxMemory(0.0),
+    dirJobs(1)
+{
+}
+
+ltx::sink::~sink()
+{
+}
+
+bool ltx::sink::confirm(
+  const string &
+) {
+  return true;
+}
+
+ltx::opCounters & ltx::opCounters::operator += (
+  const opCounters & rhs
+) {
+  dirs     += rhs.dirs;
+  entries  += rhs.entries;
+  stats    += rhs.stats;
+  removed  += rhs.removed;
+  errors   += rhs.errors;
+  timeouts += rhs.timeouts;
+  return *this;
+}
+
+// Methods for the class runContext
+
+runContext::runContext(
+  const ltx::options & o,
+  ltx::sink          & s
+) : _sink(s), opts(o), reclaim(o.reclaim)
+{
+  pthread_mutex_init(&_lock, 0);
+  for (unsigned i = 0;  i < visitedShards;  i++) {
+    pthread_mutex_init(&_visitedLock[i], 0);
+  }
+  pthread_mutex_init(&_gitLock, 0);
+  pthread_cond_init(&_gitLoaded, 0);
+}
+
+runContext::~runContext()
+{
+  pthread_mutex_destroy(&_lock);
+  for (unsigned i = 0;  i < visitedShards;  i++) {
+    pthread_mutex_destroy(&_visitedLock[i]);
+  }
+
+  for (std::list<const pruneRules *>::iterator iter = _rules.begin();
+       iter != _rules.end();  iter++) {
+    delete *iter;
+  }
+
+  pthread_cond_destroy(&_gitLoaded);
+  pthread_mutex_destroy(&_gitLock);
+
+  for (std::map<dirId, gitEntry>::iterator iter = _gitIndexes.begin();
+       iter != _gitIndexes.end();  iter++) {
+    delete iter->second.index;
+  }
+}
+
+void runContext::report(
+  const string                & path,
+  ltx::decision::action         act,
+  const string                & reason,
+  double                        bytes
+) {
+  ltx::decision d(path, act, reason, bytes);
+
+  pthread_mutex_lock(&_lock);
+  _sink.decide(d);
+  pthread_mutex_unlock(&_lock);
+}
+
+bool runContext::confirm(
+  const string & path
+) {
+  pthread_mutex_lock(&_lock);
+  bool yes = _sink.confirm(path);
+  pthread_mutex_unlock(&_lock);
+  return yes;
+}
+
+void runContext::timedOut(
+  const string & what
+) {
+  pthread_mutex_lock(&_lock);
+  _timedOut.push_back(what);
+  pthread_mutex_unlock(&_lock);
+}
+
+void runContext::timedOut(
+  std::vector<string> & list
+) {
+  pthread_mutex_lock(&_lock);
+  list = _timedOut;
+  pthread_mutex_unlock(&_lock);
+}
+
+bool runContext::firstVisit(
+  dev_t dev,
+  ino_t ino
+) {
+  // Marks the directory (dev, ino) as visited; returns false if it
+  // already was.
+
+  unsigned shard = static_cast<unsigned>(ino % visitedShards);
+
+  pthread_mutex_lock(&_visitedLock[shard]);
+  bool first = _visited[shard].insert(dirId(dev, ino)).second;
+  pthread_mutex_unlock(&_visitedLock[shard]);
+  return first;
+}
+
+const pruneRules * runContext::keep(
+  const pruneRules * rules
+) {
+  pthread_mutex_lock(&_lock);
+  _rules.push_back(rules);
+  pthread_mutex_unlock(&_lock);
+  return rules;
+}
+
+const gitIndex * runContext::gitIndexFor(
+  dev_t          dev,
+  ino_t          ino,
+  const string & workTree
+) {
+  // Returns the index of the work tree "workTree", whose top directory
+  // is (dev, ino), loading it the first time; if it cannot be read, it
+  // is returned all the same (not readable: nothing is to be removed).
+  // Other threads wait for the loading to be complete.
+
+  pthread_mutex_lock(&_gitLock);
+
+  std::map<dirId, gitEntry>::iterator where =
+    _gitIndexes.find(dirId(dev, ino));
+
+  if (where == _gitIndexes.end()) {
+    gitIndex * index = new gitIndex;
+    gitEntry   entry;
+
+    entry.index   = index;
+    entry.loading = true;
+    where = _gitIndexes.insert(std::make_pair(dirId(dev, ino),
+                                              entry)).first;
+    pthread_mutex_unlock(&_gitLock);
+
+    index->load(workTree);
+
+    pthread_mutex_lock(&_gitLock);
+    where->second.loading = false;
+    pthread_cond_broadcast(&_gitLoaded);
+
+  } else {
+    while (where->second.loading) {
+      pthread_cond_wait(&_gitLoaded, &_gitLock);
+    }
+  }
+
+  const gitIndex * index = where->second.index;
+  pthread_mutex_unlock(&_gitLock);
+  return index;
+}
+
+// The entry point
+
+void ltx::clean(
+  const std::list<string> & targets,
+  const options           & opts,
+  sink                    & out,
+  summary                 & result
+) {
+  // Cleans the directories in "targets"; questions to the sink and
+  // concurrent scans don't mix well, so "confirm" implies a single
+  // scanner thread, and no helpers for huge directories.
+
+  options o(opts);
+  if (o.confirm) o.jobs = o.dirJobs = 1;
+
+  runContext ctx(o, out);
+  string     error;
+
+  if (! o.config.empty()  &&  ! ctx.exts.load(o.config, error)) {
+    ctx.report(o.config, decision::skipped, error);
+
+  } else if (o.locateDb.empty()) {
+    scan_tree(ctx, targets, result.devices);
+
+  } else {
+
+    // The directories holding .tex files in the subtrees of the targets
+    // are taken from the locate database, and scanned one by one; the
+    // database holds absolute paths, without symbolic links.
+
+    std::list<string> roots, dirs;
+    char              resolved[PATH_MAX];
+
+    for (std::list<string>::const_iterator iter = targets.begin();
+         iter != targets.end();  iter++) {
+      if (realpath(iter->c_str(), resolved) != 0) {
+        roots.push_back(resolved);
+      } else {
+        ctx.report(*iter, decision::skipped,
+                   "could not be opened (or is not a directory)");
+      }
+    }
+
+    if (locate_tex_dirs(o.locateDb, roots, dirs, error)) {
+      o.recurse = false;
+      scan_tree(ctx, dirs, result.devices);
+    } else {
+      ctx.report(o.locateDb, decision::skipped, error);
+    }
+  }
+
+  finish(ctx, result);
+}
+
+void ltx::clean(
+  std::istream  & in,
+  const options & opts,
+  sink          & out,
+  summary       & result
+) {
+  // Cleans the files whose paths are read from "in", NUL-delimited
+
+  runContext ctx(opts, out);
+  string     error;
+
+  if (! opts.config.empty()  &&  ! ctx.exts.load(opts.config, error)) {
+    ctx.report(opts.config, decision::skipped, error);
+  } else {
+    scan_list(ctx, in, result.devices);
+  }
+  finish(ctx, result);
+}
+
+namespace {
+  void finish(
+    runContext   & ctx,
+    ltx::summary & result
+  ) {
+    // Removes the files chosen to reclaim space, if asked for; then
+    // collects the operations given up.
+
+    if (ctx.opts.reclaim > 0.0) {
+      ltx::opCounters scratch;
+
+      fsops_bind(&ctx, 0, &scratch);
+      fs_unstick();
+      result.reclaimed = ctx.reclaim.finish(ctx);
+      fsops_bind(0, 0, 0);
+    }
+
+    ctx.timedOut(result.timedOut);
+  }
+}
@@ -0,0 +1,160 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef LIBLINTEX_H_
+#define LIBLINTEX_H_
+
+#include <iosfwd>
+#include <list>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include <sys/types.h>
+}
+
+// The programming interface of liblintex, the engine of "ltx".
+//
+// A clean is started by ltx::clean(), given the target directories
+// (or a stream of NUL-delimited file paths, e.g. from "find -print0",
+// to be cleaned without reading any directory: see scan_list() in
+// cleandir.cxx), an ltx::options object and an ltx::sink: every
+// decision taken about a file (removed, kept, and why) is passed to
+// the sink as soon as it is taken, instead of being printed.
+// Nothing is kept in global variables: several cleans may run at the
+// same time in the same process, each one with its own options and
+// sink.
+//
+// The sink methods are called by the scanner threads, but never at
+// the same time for the same clean.
+
+namespace ltx {
+
+  class dirCache;               // See dircache.hh
+  class fsBackend;              // See fsbackend.hh
+
+  // The options of a clean
+
+  struct options {
+    std::string trailEd;        // Trailer of editor backup files ("~")
+    bool        confirm;        // Ask the sink before removing files
+    bool        recurse;        // Scan the subdirectories too
+    bool        pretend;        // Decide, but don't remove anything
+    unsigned    jobs;           // Scanner threads for every device
+    double      maxOpsPerSec;   // Metadata operations per second (0: any)
+    bool        adaptive;       // Adapt the operations in flight...
+    double      targetLatency;  //   ... to this latency (0: automatic)
+    double      opTimeout;      // Give up operations after (0: never)
+    bool        inodeOrder;     // Examine the entries by inode number
+    unsigned    prefetch;       // Directories to prefetch (0: none)
+    std::string locateDb;       // mlocate database choosing the dirs
+    std::vector<std::string>
+                exclude;        // Subdirectories never scanned (globs)
+    bool        xdev;           // Stay on the file system of the target
+    std::string config;         // Extension rules (see exttable.hh)
+    bool        recorder;       // Clean the outputs recorded in .fls files
+    bool        git;            // Never remove files tracked by git
+    double      reclaim;        // Bytes to free, largest files first
+    bool        measure;        // Tell the space of the files removed
+    std::string checkpoint;     // Save the state of a sweep here,
+    double      checkpointEvery; //   every so many seconds;
+    bool        resume;         // Start from the saved state, if any
+    unsigned    shard;          // Clean only the subtrees of this shard,
+    unsigned    shards;         //   out of so many,
+    unsigned    shardDepth;     //   split at this depth (see cleandir.cxx).
+    dirCache  * cache;          // Directories known from previous cleans
+    fsBackend * backend;        // The file system (0: the real one)
+    bool        noSync;         // Take the attributes cached by NFS
+    double      maxMemory;      // Bytes held for a directory (0: any)
+    unsigned    dirJobs;        // Threads for a single huge directory
+
+    options();
+  };
+
+  // A decision about a path
+
+  struct decision {
+    enum action {
+      removed,                  // The file has been removed;
+      wouldRemove,              // would have been, if not pretending;
+      kept,                     // has been kept, see "reason";
+      failed,                   // could not be removed, see "reason";
+      skipped                   // the path could not be examined.
+    };
+
+    std::string path;
+    action      act;
+    std::string reason;
+    double      bytes;          // Space held, if "options::measure"
+
+    decision(const std::string & p, action a, const std::string & r = "",
+             double b = 0.0)
+      : path(p), act(a), reason(r), bytes(b) {}
+  };
+
+  // The receiver of the decisions.  confirm() is called before
+  // removing a file if "options::confirm" is set (and forces a single
+  // scanner thread); the default implementation says yes.
+
+  class sink {
+  public:
+    virtual ~sink();
+    virtual void decide(const decision &) = 0;
+    virtual bool confirm(const std::string &);
+  };
+
+  // Counters of the work done on a device
+
+  struct opCounters {
+    unsigned long dirs;         // Directories opened
+    unsigned long entries;      // Directory entries read
+    unsigned long stats;        // Calls to stat
+    unsigned long removed;      // Files removed
+    unsigned long errors;       // Failed operations
+    unsigned long timeouts;     // Operations given up
+
+    opCounters()
+      : dirs(0), entries(0), stats(0), removed(0), errors(0),
+        timeouts(0) {}
+    opCounters & operator += (const opCounters &);
+  };
+
+  struct pfCounters {
+    unsigned long issued;       // Directories prefetched, and how many
+    unsigned long hits;         //   were complete when scanned,
+    unsigned long late;         //   were still being prefetched,
+    unsigned long misses;       //   had not been prefetched at all.
+
+    pfCounters() : issued(0), hits(0), late(0), misses(0) {}
+  };
+
+  struct devStats {
+    dev_t         dev;
+    opCounters    counters;
+    unsigned long ops;          // Throttled operations,
+    double        meanLatency;  //   their mean latency (seconds);
+    double        elapsed;      // From the first to the last scan;
+    pfCounters    prefetch;     // Prefetch results.
+  };
+
+  // What is left at the end of a clean
+
+  struct summary {
+    std::vector<devStats>    devices;
+    std::vector<std::string> timedOut;    // Operations given up
+    double                   reclaimed;   // Bytes freed by "reclaim"
+
+    summary() : reclaimed(0.0) {}
+  };
+
+  void clean(const std::list<std::string> &, const options &,
+             sink &, summary &);
+  void clean(std::istream &, const options &, sink &, summary &);
+}
+
+#endif // LIBLINTEX_H_
@@ -0,0 +1,158 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <fstream>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+#include "locatedb.hh"          // Includes: list, string
+
+using std::string;
+
+// Local variables
+
+namespace {
+  const char   mlocateMagic[] = "\0mlocate";
+  const char   plocateMagic[] = "\0plocate";
+  const size_t lMagic         = 8;
+
+  const int typeFile = 0;
+  const int typeDir  = 1;
+  const int typeEnd  = 2;
+
+  const string tex(".tex");
+}
+
+// Local functions (declarations)
+
+namespace {
+  bool under_roots(const string &, const std::list<string> &);
+  bool ends_with_tex(const string &);
+}
+
+// Code
+
+bool locate_tex_dirs(
+  const string            & db,
+  const std::list<string> & roots,
+  std::list<string>       & dirs,
+  string                  & error
+) {
+  std::ifstream in(db.c_str(), std::ios::in | std::ios::binary);
+
+  if (! in) {
+    error = "could not be opened";
+    return false;
+  }
+
+  // The header: magic, configuration size (4 bytes), version, the
+  // visibility flag and two bytes of padding; then the root path and
+  // the configuration block, both skipped.
+
+  char header[lMagic + 8];
+
+  if (! in.read(header, sizeof(header))) {
+    error = "is too short";
+    return false;
+  }
+
+  if (std::memcmp(header, plocateMagic, lMagic) == 0) {
+    error = "is a plocate database, which cannot be read: list the files "
+            "with \"plocate -0\" or \"find -print0\", and clean them with "
+            "--from0 instead";
+    return false;
+  }
+
+  if (std::memcmp(header, mlocateMagic, lMagic) != 0  ||
+      header[lMagic + 4] != 0) {
+    error = "is not an mlocate database";
+    return false;
+  }
+
+  unsigned long confSize = 0;
+  for (size_t i = 0;  i < 4;  i++) {
+    confSize = (confSize << 8) |
+               static_cast<unsigned char>(header[lMagic + i]);
+  }
+
+  string root;
+  std::getline(in, root, '\0');
+  in.ignore(confSize);
+
+  // The directory records.  The entry names are not kept: a
+  // directory is chosen as soon as a .tex is found in it, and the
+  // names in the rest of its record (or in all of it, if not under
+  // the roots) are skipped without being read into a string.
+
+  string dir, name;
+  char   dirHeader[16];
+  bool   complete = true;
+
+  while (in.read(dirHeader, sizeof(dirHeader))  &&
+         std::getline(in, dir, '\0')) {
+    bool wanted = under_roots(dir, roots);
+    bool found  = false;
+    int  type;
+
+    while ((type = in.get()) != typeEnd  &&  type != EOF) {
+      if (type != typeFile  &&  type != typeDir) {
+        error = "is corrupted";
+        return false;
+      }
+      if (! wanted  ||  found) {
+        in.ignore(std::numeric_limits<std::streamsize>::max(), '\0');
+        continue;
+      }
+      std::getline(in, name, '\0');
+
+      if (type == typeFile  &&  ends_with_tex(name)) {
+        dirs.push_back(dir);
+        found = true;
+      }
+    }
+
+    if (type == EOF) {
+      complete = false;
+      break;
+    }
+  }
+
+  // The database must end exactly after a directory record
+
+  if (complete  &&  in.gcount() == 0) return true;
+
+  error = "is truncated";
+  return false;
+}
+
+namespace {
+  bool under_roots(
+    const string            & dir,
+    const std::list<string> & roots
+  ) {
+    // Tells whether "dir" is one of "roots", or is under one of them
+
+    for (std::list<string>::const_iterator iter = roots.begin();
+         iter != roots.end();  iter++) {
+      const string & r = *iter;
+
+      if (dir.compare(0, r.size(), r) != 0) continue;
+      if (dir.size() == r.size()  ||  *(r.rbegin()) == '/'  ||
+          dir[r.size()] == '/') return true;
+    }
+
+    return false;
+  }
+
+  bool ends_with_tex(
+    const string & name
+  ) {
+    return name.size() > tex.size()  &&
+           name.compare(name.size() - tex.size(), tex.size(), tex) == 0;
+  }
+}
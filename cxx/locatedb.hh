@@ -0,0 +1,35 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef LOCATEDB_H_
+#define LOCATEDB_H_
+
+#include <list>
+#include <string>
+
+// A reader for the database of mlocate (see mlocate.db(5)), used to
+// find the directories holding .tex files without walking the tree.
+//
+// The database is a header (magic "\0mlocate", configuration size,
+// version, visibility flag, root path and configuration block)
+// followed by a record for every directory: its modification time,
+// its path and its entries (a type byte, 0 for a file, 1 for a
+// subdirectory and 2 for the end of the list, followed by the name
+// for the first two).  All numbers are big-endian.
+//
+// locate_tex_dirs() reads the database "db" through, and puts in
+// "dirs" the directories in the subtrees of "roots" (absolute paths)
+// holding at least a file whose name ends with ".tex"; it returns
+// false, with the reason in "error", if the database cannot be read.
+// The databases of plocate, whose posting lists are compressed with
+// zstd, are recognized but not supported: the error suggests --from0.
+
+bool locate_tex_dirs(const std::string &, const std::list<std::string> &,
+                     std::list<std::string> &, std::string &);
+
+#endif // LOCATEDB_H_
@@ -15,14 +15,28 @@
 // -------------------------------------------------------------------
 
 #include <algorithm>
+#include <fstream>
+#include <iomanip>
 #include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include "ltx.hh"               // Includes: functional, iostream, string
-#include "cleandir.hh"          // Includes: string
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+#include "dump.hh"              // Includes: fstream, list, map, string, ...
+#include "exttable.hh"          // Includes: string, vector
+#include "memfs.hh"             // Includes: map, string, vector, ...
+#include "report.hh"            // Includes: iosfwd, list, map, set, ...
+#include "server.hh"            // Includes: string, liblintex.hh
 
 extern "C" {
   #include <getopt.h>
   #include <unistd.h>
+  #include <sys/sysmacros.h>
 }
 
 using std::cout;
@@ -32,19 +46,86 @@ using std::string;
 // Global variables (definition)
 
 namespace ltx {
-  string            progname;
-  string            trailEd("~");
-  string::size_type lTrailEd;
-  bool              confirm(false);
-  bool              recurse(false);
+  string progname;
 }
 
 using namespace ltx;
 
+// Local variables and types
+
+namespace {
+  const int answerLength(64);
+
+  // Values returned by getopt_long() for the options having no short
+  // equivalent
+
+  enum {
+    optMaxOps = 256,
+    optAdaptive,
+    optStats,
+    optTimeout,
+    optInodeOrder,
+    optMaxMemory,
+    optDirJobs,
+    optPrefetch,
+    optFrom0,
+    optLocate,
+    optExclude,
+    optXdev,
+    optNoSync,
+    optConfig,
+    optRecorder,
+    optNoGit,
+    optReclaim,
+    optReport,
+    optJson,
+    optCheckpoint,
+    optCheckpointEvery,
+    optResume,
+    optShard,
+    optShardDepth,
+    optMergeStats,
+    optServe,
+    optRecord,
+    optAnonymize,
+    optReplay
+  };
+
+  options opts;
+  bool    showStats(false);
+  bool    jsonStats(false);         // The summary in JSON, to be merged
+  bool    mergeStats(false);        //   later by this.
+  bool    showReport(false);        // Where the reclaimable space is,
+  double  reportTop(20);            //   the subtrees to be shown,
+  bool    json(false);              //   in JSON.
+  string  from0;                // File with the paths to clean ("-": stdin)
+  string  socketPath;           // Where to serve requests (see server.hh)
+  string  recordFile;           // Where to dump what is seen,
+  bool    anonymize(false);     //   with hashed names (see dump.hh);
+  string  replayFile;           // The dump to clean instead of the disk.
+
+  // The sink printing the decisions taken by the engine: removed files
+  // (or files that would be removed) and kept files on the standard
+  // output stream, errors on the standard error stream.
+
+  class printer : public sink {
+  public:
+    void decide(const decision &);
+    bool confirm(const string &);
+  };
+}
+
 // Local procedures
 
 namespace {
-  char *basename(char *);
+  char *baseName(char *);
+  bool  getNumber(const char *, double &);
+  bool  getBytes(const char *, double &);
+  bool  getShard(const char *, unsigned &, unsigned &);
+  void  printStats(const std::vector<devStats> &);
+  void  printJsonStats(const std::vector<devStats> &);
+  bool  jsonNumber(const string &, const char *, double &);
+  int   printMerged(const std::list<string> &);
   void  syntax();
 }
 
@@ -56,31 +137,242 @@ int main(
 
   // Gets the executable name
 
-  progname = argv[0] = basename(argv[0]);
+  progname = argv[0] = baseName(argv[0]);
 
   // Decodes the command line options and arguments
 
-  char          shortOpts[] = "irb::";
+  char          shortOpts[] = "irpb::j:";
   struct option longOpts[]  = {
-    {"interactive", no_argument,       0, 'i'},
-    {"recursive",   no_argument,       0, 'r'},
-    {"backup",      optional_argument, 0, 'b'},
-    { 0,            0,                 0,  0}
+    {"interactive",     no_argument,       0, 'i'},
+    {"recursive",       no_argument,       0, 'r'},
+    {"pretend",         no_argument,       0, 'p'},
+    {"backup",          optional_argument, 0, 'b'},
+    {"jobs",            required_argument, 0, 'j'},
+    {"max-ops-per-sec", required_argument, 0, optMaxOps},
+    {"adaptive",        optional_argument, 0, optAdaptive},
+    {"stats",           optional_argument, 0, optStats},
+    {"op-timeout",      required_argument, 0, optTimeout},
+    {"inode-order",     no_argument,       0, optInodeOrder},
+    {"max-memory",      required_argument, 0, optMaxMemory},
+    {"dir-jobs",        required_argument, 0, optDirJobs},
+    {"prefetch",        required_argument, 0, optPrefetch},
+    {"from0",           required_argument, 0, optFrom0},
+    {"locate",          optional_argument, 0, optLocate},
+    {"exclude",         required_argument, 0, optExclude},
+    {"xdev",            no_argument,       0, optXdev},
+    {"no-sync",         no_argument,       0, optNoSync},
+    {"config",          required_argument, 0, optConfig},
+    {"recorder",        no_argument,       0, optRecorder},
+    {"no-git",          no_argument,       0, optNoGit},
+    {"reclaim",         required_argument, 0, optReclaim},
+    {"report",          optional_argument, 0, optReport},
+    {"json",            no_argument,       0, optJson},
+    {"checkpoint",      required_argument, 0, optCheckpoint},
+    {"checkpoint-every", required_argument, 0, optCheckpointEvery},
+    {"resume",          no_argument,       0, optResume},
+    {"shard",           required_argument, 0, optShard},
+    {"shard-depth",     required_argument, 0, optShardDepth},
+    {"merge-stats",     no_argument,       0, optMergeStats},
+    {"serve",           required_argument, 0, optServe},
+    {"record",          required_argument, 0, optRecord},
+    {"anonymize",       no_argument,       0, optAnonymize},
+    {"replay",          required_argument, 0, optReplay},
+    { 0,                0,                 0,  0}
   };
 
-  int c;
+  int    c;
+  double value;
   while ((c = getopt_long(argc, argv, shortOpts, longOpts, 0)) != -1) {
     switch (c) {
       case 'i':
-        confirm = true;
+        opts.confirm = true;
         break;
 
       case 'r':
-        recurse = true;
+        opts.recurse = true;
+        break;
+
+      case 'p':
+        opts.pretend = true;
         break;
 
       case 'b':
-        trailEd = optarg ? optarg : "";
+        opts.trailEd = optarg ? optarg : "";
+        break;
+
+      case 'j':
+        if (! getNumber(optarg, value)  ||  value < 1.0) {
+          syntax();
+          return 1;
+        }
+        opts.jobs = static_cast<unsigned>(value);
+        break;
+
+      case optMaxOps:
+        if (! getNumber(optarg, value)) {
+          syntax();
+          return 1;
+        }
+        opts.maxOpsPerSec = value;
+        break;
+
+      case optAdaptive:
+        opts.adaptive = true;
+        if (optarg) {
+          if (! getNumber(optarg, value)) {
+            syntax();
+            return 1;
+          }
+          opts.targetLatency = value / 1000.0;
+        }
+        break;
+
+      case optStats:
+        if (optarg  &&  std::strcmp(optarg, "json") != 0) {
+          syntax();
+          return 1;
+        }
+        showStats = true;
+        jsonStats = optarg != 0;
+        break;
+
+      case optTimeout:
+        if (! getNumber(optarg, value)) {
+          syntax();
+          return 1;
+        }
+        opts.opTimeout = value;
+        break;
+
+      case optInodeOrder:
+        opts.inodeOrder = true;
+        break;
+
+      case optMaxMemory:
+        if (! getBytes(optarg, value)  ||  value <= 0.0) {
+          syntax();
+          return 1;
+        }
+        opts.maxMemory = value;
+        break;
+
+      case optDirJobs:
+        if (! getNumber(optarg, value)  ||  value < 1.0) {
+          syntax();
+          return 1;
+        }
+        opts.dirJobs = static_cast<unsigned>(value);
+        break;
+
+      case optPrefetch:
+        if (! getNumber(optarg, value)) {
+          syntax();
+          return 1;
+        }
+        opts.prefetch = static_cast<unsigned>(value);
+        break;
+
+      case optFrom0:
+        from0 = optarg;
+        break;
+
+      case optLocate:
+        opts.locateDb = optarg ? optarg : "/var/lib/mlocate/mlocate.db";
+        break;
+
+      case optExclude:
+        opts.exclude.push_back(optarg);
+        break;
+
+      case optXdev:
+        opts.xdev = true;
+        break;
+
+      case optNoSync:
+        opts.noSync = true;
+        break;
+
+      case optConfig:
+        opts.config = optarg;
+        break;
+
+      case optRecorder:
+        opts.recorder = true;
+        break;
+
+      case optNoGit:
+        opts.git = false;
+        break;
+
+      case optReclaim:
+        if (! getBytes(optarg, value)  ||  value <= 0.0) {
+          syntax();
+          return 1;
+        }
+        opts.reclaim = value;
+        break;
+
+      case optReport:
+        if (optarg  &&  ! getNumber(optarg, reportTop)) {
+          syntax();
+          return 1;
+        }
+        showReport = true;
+        break;
+
+      case optJson:
+        json = true;
+        break;
+
+      case optCheckpoint:
+        opts.checkpoint = optarg;
+        break;
+
+      case optCheckpointEvery:
+        if (! getNumber(optarg, value)  ||  value <= 0.0) {
+          syntax();
+          return 1;
+        }
+        opts.checkpointEvery = value;
+        break;
+
+      case optResume:
+        opts.resume = true;
+        break;
+
+      case optShard:
+        if (! getShard(optarg, opts.shard, opts.shards)) {
+          syntax();
+          return 1;
+        }
+        break;
+
+      case optShardDepth:
+        if (! getNumber(optarg, value)) {
+          syntax();
+          return 1;
+        }
+        opts.shardDepth = static_cast<unsigned>(value);
+        break;
+
+      case optMergeStats:
+        mergeStats = true;
+        break;
+
+      case optServe:
+        socketPath = optarg;
+        break;
+
+      case optRecord:
+        recordFile = optarg;
+        break;
+
+      case optAnonymize:
+        anonymize = true;
+        break;
+
+      case optReplay:
+        replayFile = optarg;
         break;
 
       case 'h':
@@ -97,20 +389,140 @@ int main(
 
   while (optind < argc) targets.push_back( argv[optind++] );
 
-  // Computes the length of the extension identifying the backup
-  // files, and, if no target directories were explicitly given,
-  // scans the current one.
+  // Merging the summaries of the shards of a sweep, the arguments are
+  // the files holding them; nothing is cleaned.
+
+  if (mergeStats) {
+    if (targets.empty()) {
+      syntax();
+      return 1;
+    }
+    return printMerged(targets);
+  }
+
+  // A server takes the directories from its clients
+
+  if (! socketPath.empty()) {
+    if (! targets.empty()  ||  ! from0.empty()  ||  opts.confirm  ||
+        showReport  ||  opts.reclaim > 0.0  ||  ! opts.checkpoint.empty()  ||
+        ! recordFile.empty()  ||  ! replayFile.empty()) {
+      syntax();
+      return 1;
+    }
+    return serve(socketPath, opts);
+  }
+
+  // The paths to be cleaned come either from the command line or from
+  // a list; if no target directories were explicitly given, scans the
+  // current one.
+
+  if (! from0.empty()  &&  (! targets.empty()  ||
+                          ! opts.locateDb.empty()  ||
+                          ! opts.checkpoint.empty())) {
+    syntax();
+    return 1;
+  }
+
+  // A sweep may be resumed only from a checkpoint
+
+  if (opts.resume  &&  opts.checkpoint.empty()) {
+    syntax();
+    return 1;
+  }
+
+  // A replay cleans the targets recorded in the dump (see dump.hh),
+  // on a copy of the tree held in memory
+
+  ltx::memBackend replayed;
+
+  if (! replayFile.empty()) {
+    string error;
+
+    if (! targets.empty()  ||  ! from0.empty()  ||  ! recordFile.empty()  ||
+        ! opts.locateDb.empty()) {
+      syntax();
+      return 1;
+    }
+    if (! load_dump(replayFile, replayed, targets, error)) {
+      std::cerr << progname << ": \"" << replayFile << "\" " << error
+                << '\n';
+      return 1;
+    }
+    opts.backend = &replayed;
+  }
 
-  lTrailEd = trailEd.size();
+  if (from0.empty()  &&  targets.empty()) targets.push_back(".");
 
-  if (targets.empty()) targets.push_back(".");
+  // What the scanner sees is recorded, if asked for, on its way from
+  // the file system in use
+
+  std::auto_ptr<ltx::dumpBackend> recorder;
+
+  if (! recordFile.empty()) {
+    if (! from0.empty()) {
+      syntax();
+      return 1;
+    }
+
+    // The names are anonymized keeping the extensions the clean will
+    // know of (an unreadable configuration is reported by the clean)
+
+    extTable exts;
+    string   error;
+
+    if (anonymize  &&  ! opts.config.empty()) exts.load(opts.config, error);
+
+    recorder.reset(new ltx::dumpBackend(
+      opts.backend ? *opts.backend : ltx::posix_backend(), recordFile,
+      anonymize, exts, opts.trailEd));
+
+    if (! recorder->good()) {
+      std::cerr << progname << ": \"" << recordFile
+                << "\" cannot be written\n";
+      return 1;
+    }
+    for (std::list<string>::const_iterator iter = targets.begin();
+         iter != targets.end();  iter++) {
+      recorder->target(*iter);
+    }
+    opts.backend = recorder.get();
+
+  } else if (anonymize) {
+    syntax();
+    return 1;
+  }
 
 #if defined(DEBUG)
   cout << "--------------------Argument analysis\n";
-  cout << "Confirm = " << confirm << endl;
-  cout << "Recurse = " << recurse << endl;
-  cout << "Trailing editor extension = \"" << trailEd
-       << "\" (length " << lTrailEd << ")\n";
+  cout << "Confirm = " << opts.confirm << endl;
+  cout << "Recurse = " << opts.recurse << endl;
+  cout << "Pretend = " << opts.pretend << endl;
+  cout << "Jobs = " << opts.jobs << endl;
+  cout << "Max ops/s = " << opts.maxOpsPerSec << endl;
+  cout << "Adaptive = " << opts.adaptive << " (target "
+       << opts.targetLatency << " s)\n";
+  cout << "Operation timeout = " << opts.opTimeout << " s\n";
+  cout << "Inode order = " << opts.inodeOrder << endl;
+  cout << "Prefetch = " << opts.prefetch << endl;
+  cout << "Path list = \"" << from0 << "\"\n";
+  cout << "Locate database = \"" << opts.locateDb << "\"\n";
+  cout << "Exclude:\n";
+  for_each(opts.exclude.begin(), opts.exclude.end(), printBefore("  "));
+  cout << "Stay on one file system = " << opts.xdev << endl;
+  cout << "Configuration = \"" << opts.config << "\"\n";
+  cout << "Recorder = " << opts.recorder << endl;
+  cout << "Protect git files = " << opts.git << endl;
+  cout << "Reclaim = " << opts.reclaim << " bytes\n";
+  cout << "Memory cap = " << opts.maxMemory << " bytes\n";
+  cout << "Threads for a huge directory = " << opts.dirJobs << endl;
+  cout << "Checkpoint = \"" << opts.checkpoint << "\" (every "
+       << opts.checkpointEvery << " s, resume " << opts.resume << ")\n";
+  cout << "Shard = " << opts.shard << '/' << opts.shards << " (depth "
+       << opts.shardDepth << ")\n";
+  cout << "Report = " << showReport << " (top " << reportTop
+       << (json ? ", JSON)\n" : ")\n");
+  cout << "Trailing editor extension = \"" << opts.trailEd
+       << "\" (length " << opts.trailEd.size() << ")\n";
   cout << "Target directories:\n";
 
   for_each(targets.begin(), targets.end(), printBefore("  "));
@@ -118,13 +530,121 @@ int main(
 
   // Scans in turn all the wanted directories
 
-  for_each(targets.begin(), targets.end(), std::ptr_fun(scan_dir));
+  // The report of the reclaimable space needs a pretend run, measuring
+  // the files that would be removed.
+
+  printer     out;
+  spaceReport report(targets, out);
+  sink      & where = showReport ? static_cast<sink &>(report) : out;
+  summary     result;
+
+  if (showReport) {
+    opts.pretend = true;
+    opts.measure = true;
+  }
+
+  if (from0.empty()) {
+    clean(targets, opts, where, result);
+
+  } else if (from0 == "-") {
+    clean(std::cin, opts, where, result);
+
+  } else {
+    std::ifstream list(from0.c_str(), std::ios::in | std::ios::binary);
+
+    if (! list) {
+      std::cerr << progname << ": \"" << from0
+                << "\" could not be opened\n";
+      return 1;
+    }
+    clean(list, opts, where, result);
+  }
+
+  if (recorder.get()  &&  ! recorder->close()) {
+    std::cerr << progname << ": \"" << recordFile
+              << "\" could not be written\n";
+  }
+
+  if (showReport) {
+    report.print(cout, static_cast<unsigned>(reportTop), json);
+  }
+  if (showStats) {
+    if (jsonStats) printJsonStats(result.devices);
+    else           printStats(result.devices);
+  }
+
+  if (opts.reclaim > 0.0) {
+    cout << std::fixed << std::setprecision(0) << result.reclaimed
+         << " bytes " << (opts.pretend ? "would be" : "have been")
+         << " freed";
+    if (result.reclaimed < opts.reclaim) {
+      cout << ", less than the " << opts.reclaim << " asked for";
+    }
+    cout << ".\n";
+  }
+
+  // Lists the operations that were given up, if any
+
+  const std::vector<string> & timedOut = result.timedOut;
+
+  if (! timedOut.empty()) {
+    std::cerr << progname << ": " << timedOut.size()
+              << " operation(s) timed out:\n";
+    for_each(timedOut.begin(), timedOut.end(),
+             printBefore("  ", std::cerr));
+    return 1;
+  }
 
   return 0;
 }
 
 namespace {
-  char *basename(
+  void printer::decide(
+    const decision & d
+  ) {
+    switch (d.act) {
+      case decision::removed:
+        cout << d.path << " has been removed.\n";
+        break;
+
+      case decision::wouldRemove:
+        cout << d.path << " would be removed.\n";
+        break;
+
+      case decision::kept:
+        cout << d.path << " not removed; " << d.reason << '\n';
+        break;
+
+      case decision::failed:
+        std::cerr << progname << ": cannot remove " << d.path
+                  << ": " << d.reason << '\n';
+        break;
+
+      case decision::skipped:
+        std::cerr << progname << ": \"" << d.path << "\" "
+                  << d.reason << '\n';
+        break;
+    }
+  }
+
+  bool printer::confirm(
+    const string & path
+  ) {
+    char answer[answerLength], c;
+
+    do {
+      cout << "Remove " << path << " (y|n) ? ";
+      std::cin.get(answer, answerLength);
+      if (std::cin.gcount() < answerLength-1 ) {
+        std::cin.ignore();
+      }
+      c = tolower(static_cast<unsigned char>(answer[0]));
+    } while (c != 'y'  &&  c != 'n');
+
+    return c == 'y';
+  }
+
+  char *baseName(
     char *pc
   ) {
     // Strips the (eventual) path name from the full file name pointed
@@ -135,6 +655,339 @@ namespace {
     return ++p;
   }
 
+  bool getBytes(
+    const char *text,
+    double     &value
+  ) {
+    // Decodes a number of bytes, with an optional suffix K, M, G or T
+    // (powers of 1024); returns false (after printing an error
+    // message) if it cannot be decoded.
+
+    char *end;
+
+    value = std::strtod(text, &end);
+
+    if (end != text  &&  value >= 0.0) {
+      const char * suffixes = "KMGT";
+      const char * where;
+
+      if (*end != '\0'  &&  end[1] == '\0'  &&
+          (where = std::strchr(suffixes, std::toupper(*end))) != 0) {
+        for (const char * p = suffixes;  p <= where;  p++) value *= 1024.0;
+        end++;
+      }
+      if (*end == '\0') return true;
+    }
+
+    std::cerr << progname << ": \"" << text
+              << "\" is not a valid number of bytes\n";
+    return false;
+  }
+
+  bool getShard(
+    const char *text,
+    unsigned   &shard,
+    unsigned   &shards
+  ) {
+    // Decodes "I/N", the shard I (from 0) out of N; returns false
+    // (after printing an error message) if it cannot be decoded.
+
+    char          *end;
+    unsigned long  i = std::strtoul(text, &end, 10);
+
+    if (end != text  &&  *end == '/') {
+      const char    *slash = end;
+      unsigned long  n     = std::strtoul(slash + 1, &end, 10);
+
+      if (end != slash + 1  &&  *end == '\0'  &&  i < n  &&
+          std::isdigit(static_cast<unsigned char>(*text))) {
+        shard  = static_cast<unsigned>(i);
+        shards = static_cast<unsigned>(n);
+        return true;
+      }
+    }
+
+    std::cerr << progname << ": \"" << text
+              << "\" is not a valid shard (I/N, with I < N)\n";
+    return false;
+  }
+
+  bool getNumber(
+    const char *text,
+    double     &value
+  ) {
+    // Decodes the non negative number in "text"; returns false (after
+    // printing an error message) if it cannot be decoded.
+
+    char *end;
+
+    value = std::strtod(text, &end);
+    if (end == text  ||  *end != '\0'  ||  value < 0.0) {
+      std::cerr << progname << ": \"" << text
+                << "\" is not a valid number\n";
+      return false;
+    }
+    return true;
+  }
+
+  void printStats(
+    const std::vector<devStats> & stats
+  ) {
+    // Prints on the standard error stream the summary of the work done
+    // on every device, and the throughput obtained.
+
+    using std::cerr;
+    using std::setw;
+
+    cerr << "\n  Device     Dirs  Entries    Stats  Removed   Errors"
+            " Timeouts      Ops  Lat(ms)  Time(s)  Entries/s\n";
+
+    for (std::vector<devStats>::const_iterator iter = stats.begin();
+         iter != stats.end();  iter++) {
+      const opCounters & c = iter->counters;
+      std::ostringstream dev;
+
+      dev << major(iter->dev) << ':' << minor(iter->dev);
+      cerr << setw(8) << dev.str()
+           << ' ' << setw(8) << c.dirs
+           << ' ' << setw(8) << c.entries
+           << ' ' << setw(8) << c.stats
+           << ' ' << setw(8) << c.removed
+           << ' ' << setw(8) << c.errors
+           << ' ' << setw(8) << c.timeouts
+           << ' ' << setw(8) << iter->ops
+           << std::fixed << std::setprecision(3)
+           << ' ' << setw(8) << iter->meanLatency * 1000.0
+           << ' ' << setw(8) << iter->elapsed
+           << std::setprecision(0)
+           << ' ' << setw(10)
+           << (iter->elapsed > 0.0 ? c.entries / iter->elapsed : 0.0)
+           << '\n';
+    }
+
+    if (opts.prefetch == 0) return;
+
+    cerr << "\n  Device   Issued     Hits     Late   Misses   Hit(%)\n";
+
+    for (std::vector<devStats>::const_iterator iter = stats.begin();
+         iter != stats.end();  iter++) {
+      const pfCounters & pf = iter->prefetch;
+      unsigned long      taken = pf.hits + pf.late + pf.misses;
+      std::ostringstream dev;
+
+      dev << major(iter->dev) << ':' << minor(iter->dev);
+      cerr << setw(8) << dev.str()
+           << ' ' << setw(8) << pf.issued
+           << ' ' << setw(8) << pf.hits
+           << ' ' << setw(8) << pf.late
+           << ' ' << setw(8) << pf.misses
+           << std::setprecision(1)
+           << ' ' << setw(8) << (taken ? 100.0 * pf.hits / taken : 0.0)
+           << '\n';
+    }
+  }
+
+  void printJsonStats(
+    const std::vector<devStats> & stats
+  ) {
+    // Prints on the standard error stream, on a single line, the
+    // summary of the work done: the shard, the totals, then every
+    // device.  The lines of all the shards of a sweep are added up by
+    // printMerged().
+
+    std::ostringstream line;
+    opCounters         all;
+    unsigned long      ops(0);
+    double             elapsed(0.0);
+
+    for (std::vector<devStats>::const_iterator iter = stats.begin();
+         iter != stats.end();  iter++) {
+      all += iter->counters;
+      ops += iter->ops;
+      if (iter->elapsed > elapsed) elapsed = iter->elapsed;
+    }
+
+    line << std::fixed << std::setprecision(3)
+         << "{\"shard\": " << opts.shard << ", \"shards\": " << opts.shards
+         << ", \"depth\": " << opts.shardDepth
+         << ", \"dirs\": " << all.dirs << ", \"entries\": " << all.entries
+         << ", \"stats\": " << all.stats << ", \"removed\": " << all.removed
+         << ", \"errors\": " << all.errors
+         << ", \"timeouts\": " << all.timeouts << ", \"ops\": " << ops
+         << ", \"elapsed\": " << elapsed << ", \"devices\": [";
+
+    for (std::vector<devStats>::const_iterator iter = stats.begin();
+         iter != stats.end();  iter++) {
+      const opCounters & c = iter->counters;
+
+      line << (iter == stats.begin() ? "" : ", ")
+           << "{\"dev\": \"" << major(iter->dev) << ':' << minor(iter->dev)
+           << "\", \"dirs\": " << c.dirs << ", \"entries\": " << c.entries
+           << ", \"stats\": " << c.stats << ", \"removed\": " << c.removed
+           << ", \"errors\": " << c.errors
+           << ", \"timeouts\": " << c.timeouts << ", \"ops\": " << iter->ops
+           << ", \"latency\": " << iter->meanLatency * 1000.0
+           << ", \"elapsed\": " << iter->elapsed << '}';
+    }
+
+    line << "]}";
+    std::cerr << line.str() << endl;
+  }
+
+  bool jsonNumber(
+    const string &line,
+    const char   *key,
+    double       &value
+  ) {
+    // Gets the number following the first "key": in "line"
+
+    string            tag   = string("\"") + key + "\": ";
+    string::size_type where = line.find(tag);
+
+    if (where == string::npos) return false;
+
+    const char *text = line.c_str() + where + tag.size();
+    char       *end;
+
+    value = std::strtod(text, &end);
+    return end != text;
+  }
+
+  int printMerged(
+    const std::list<string> & files
+  ) {
+    // Adds up the summaries printed by --stats=json in "files", one
+    // for every shard of a sweep (any other line, e.g. an error
+    // message, is ignored), and prints the totals; in JSON if --json
+    // was given.  Returns 1 if a shard is missing or given twice.
+
+    using std::setw;
+
+    static const char * const fields[] = {
+      "dirs", "entries", "stats", "removed", "errors", "timeouts", "ops"
+    };
+    const unsigned nFields = sizeof(fields) / sizeof(fields[0]);
+
+    typedef std::map< unsigned, std::vector<double> > shardMap;
+
+    shardMap shards;
+    double   count(0.0);
+    bool     good(true);
+
+    for (std::list<string>::const_iterator iter = files.begin();
+         iter != files.end();  iter++) {
+      std::ifstream in(iter->c_str());
+      string        line;
+
+      if (! in) {
+        std::cerr << progname << ": \"" << *iter
+                  << "\" could not be opened\n";
+        return 1;
+      }
+
+      while (std::getline(in, line)) {
+        if (line.compare(0, 10, "{\"shard\": ") != 0) continue;
+
+        // The totals come before the devices
+
+        string              head = line.substr(0, line.find("\"devices\""));
+        std::vector<double> values(nFields + 1);
+        double              shard, n;
+        bool                ok = jsonNumber(head, "shard", shard)  &&
+                                 jsonNumber(head, "shards", n)  &&
+                                 jsonNumber(head, "elapsed", values[nFields]);
+
+        for (unsigned i = 0;  ok  &&  i < nFields;  i++) {
+          ok = jsonNumber(head, fields[i], values[i]);
+        }
+
+        if (! ok  ||  (count != 0.0  &&  n != count)) {
+          std::cerr << progname << ": \"" << *iter << "\" holds "
+                    << (ok ? "another sweep" : "a malformed summary")
+                    << '\n';
+          return 1;
+        }
+        count = n;
+
+        unsigned key = static_cast<unsigned>(shard);
+
+        if (shards.count(key) != 0) {
+          std::cerr << progname << ": shard " << key << '/' << count
+                    << " given twice\n";
+          good = false;
+        }
+        shards[key] = values;
+      }
+    }
+
+    // The shards run at the same time: the time of the sweep is that of
+    // the slowest one.
+
+    std::vector<double>   total(nFields + 1);
+    std::vector<unsigned> missing;
+
+    for (shardMap::const_iterator iter = shards.begin();
+         iter != shards.end();  iter++) {
+      for (unsigned i = 0;  i < nFields;  i++) total[i] += iter->second[i];
+      if (iter->second[nFields] > total[nFields]) {
+        total[nFields] = iter->second[nFields];
+      }
+    }
+    for (unsigned i = 0;  i < count;  i++) {
+      if (shards.count(i) == 0) missing.push_back(i);
+    }
+
+    std::ios::fmtflags flags = cout.flags();
+    cout << std::fixed << std::setprecision(0);
+
+    if (json) {
+      cout << "{\"shards\": " << count << ", \"merged\": " << shards.size()
+           << ", \"missing\": [";
+      for (std::vector<unsigned>::const_iterator iter = missing.begin();
+           iter != missing.end();  iter++) {
+        cout << (iter == missing.begin() ? "" : ", ") << *iter;
+      }
+      cout << ']';
+      for (unsigned i = 0;  i < nFields;  i++) {
+        cout << ", \"" << fields[i] << "\": " << total[i];
+      }
+      cout << std::setprecision(3) << ", \"elapsed\": " << total[nFields]
+           << "}\n";
+
+    } else {
+      cout << "\n   Shard     Dirs  Entries    Stats  Removed   Errors"
+              " Timeouts      Ops  Time(s)\n";
+
+      for (shardMap::const_iterator iter = shards.begin();
+           iter != shards.end();  iter++) {
+        std::ostringstream shard;
+
+        shard << iter->first << '/' << count;
+        cout << setw(8) << shard.str();
+        for (unsigned i = 0;  i < nFields;  i++) {
+          cout << ' ' << setw(8) << iter->second[i];
+        }
+        cout << std::setprecision(3) << ' ' << setw(8)
+             << iter->second[nFields] << std::setprecision(0) << '\n';
+      }
+
+      cout << setw(8) << "(total)";
+      for (unsigned i = 0;  i < nFields;  i++) {
+        cout << ' ' << setw(8) << total[i];
+      }
+      cout << std::setprecision(3) << ' ' << setw(8) << total[nFields]
+           << '\n';
+    }
+
+    cout.flags(flags);
+
+    if (! missing.empty()) {
+      std::cerr << progname << ": " << missing.size() << " shard(s) missing\n";
+      good = false;
+    }
+    return good ? 0 : 1;
+  }
+
   void syntax()
   {
     cout <<
@@ -152,15 +1005,174 @@ namespace {
       "Options: -i     | --interactive : asks before removing files;\n";
     cout <<
       "\t -r     | --recursive   : scans recursively the given directories;\n";
+    cout <<
+      "\t -p     | --pretend     : shows what would be removed, but removes "
+      "nothing;\n";
     cout <<
       "\t -b=ext | --backup=ext  : \"ext\" is the trailing string "
       "identifying\n";
     cout <<
-      "\t\t\t\t  editor backup files.\n";
+      "\t\t\t\t  editor backup files;\n";
+    cout <<
+      "\t -j n   | --jobs=n      : scans up to \"n\" directories at the "
+      "same time;\n";
+    cout <<
+      "\t --max-ops-per-sec=n    : issues at most \"n\" file system "
+      "operations\n";
+    cout <<
+      "\t\t\t\t  (stat, unlink, readdir) per second;\n";
+    cout <<
+      "\t --adaptive[=ms]        : adapts the number of operations in "
+      "flight\n";
+    cout <<
+      "\t\t\t\t  to their latency, aiming at \"ms\" milliseconds\n";
+    cout <<
+      "\t\t\t\t  (default: a few times the best latency seen);\n";
+    cout <<
+      "\t --op-timeout=s         : gives up any directory where a file "
+      "system\n";
+    cout <<
+      "\t\t\t\t  operation takes more than \"s\" seconds;\n";
+    cout <<
+      "\t --inode-order          : examines files and subdirectories in "
+      "inode\n";
+    cout <<
+      "\t\t\t\t  order (faster on cold spinning disks);\n";
+    cout <<
+      "\t --max-memory=n[KMGT]   : holds no more than about \"n\" bytes for "
+      "a\n";
+    cout <<
+      "\t\t\t\t  directory, spilling the rest to temporary files;\n";
+    cout <<
+      "\t --dir-jobs=n           : examines and cleans a huge directory with "
+      "\"n\"\n";
+    cout <<
+      "\t\t\t\t  threads;\n";
+    cout <<
+      "\t --prefetch=k           : warms the caches for the next \"k\" "
+      "directories\n";
+    cout <<
+      "\t\t\t\t  to be scanned on every device;\n";
+    cout <<
+      "\t --from0=file           : cleans the files listed in \"file\" "
+      "(\"-\": the\n";
+    cout <<
+      "\t\t\t\t  standard input), NUL-delimited, without reading\n";
+    cout <<
+      "\t\t\t\t  any directory (no directory may be given);\n";
+    cout <<
+      "\t --locate[=db]          : scans only the directories holding .tex "
+      "files\n";
+    cout <<
+      "\t\t\t\t  in the given subtrees, according to the mlocate\n";
+    cout <<
+      "\t\t\t\t  database \"db\" (default: "
+      "/var/lib/mlocate/mlocate.db);\n";
+    cout <<
+      "\t --exclude=glob         : never scans the subdirectories whose "
+      "name\n";
+    cout <<
+      "\t\t\t\t  matches \"glob\" (may be repeated; more rules\n";
+    cout <<
+      "\t\t\t\t  are read from the .lintexignore files);\n";
+    cout <<
+      "\t --xdev                 : never leaves the file system of "
+      "the targets;\n";
+    cout <<
+      "\t --no-sync              : takes the file attributes cached by "
+      "network\n";
+    cout <<
+      "\t\t\t\t  file systems, without asking the server;\n";
+    cout <<
+      "\t --config=file          : reads more extension rules from "
+      "\"file\"\n";
+    cout <<
+      "\t\t\t\t  (\"ext .fls .run.xml ...\", \"keep .pdf ...\");\n";
+    cout <<
+      "\t --recorder             : removes only the outputs listed in the "
+      ".fls\n";
+    cout <<
+      "\t\t\t\t  (or .fdb_latexmk) of every .tex found or given;\n";
+    cout <<
+      "\t --no-git               : removes even the files tracked by git "
+      "(which\n";
+    cout <<
+      "\t\t\t\t  are otherwise always kept);\n";
+    cout <<
+      "\t --reclaim=n[KMGT]      : removes the largest files first, until "
+      "\"n\"\n";
+    cout <<
+      "\t\t\t\t  bytes have been freed;\n";
+    cout <<
+      "\t --report[=n] [--json]  : removes nothing, but shows the \"n\" "
+      "subtrees\n";
+    cout <<
+      "\t\t\t\t  with the most reclaimable space (default 20);\n";
+    cout <<
+      "\t --checkpoint=file      : saves the state of the sweep in \"file\" "
+      "(and\n";
+    cout <<
+      "\t\t\t\t  \"file.done\") every minute, or every \"s\" seconds\n";
+    cout <<
+      "\t\t\t\t  if --checkpoint-every=s is given; both are\n";
+    cout <<
+      "\t\t\t\t  removed when the sweep is over;\n";
+    cout <<
+      "\t --resume               : goes on from the state saved by "
+      "--checkpoint,\n";
+    cout <<
+      "\t\t\t\t  if any, instead of starting from the targets;\n";
+    cout <<
+      "\t --shard=i/n            : cleans only the i-th (from 0) of \"n\" "
+      "disjoint\n";
+    cout <<
+      "\t\t\t\t  parts of the targets, chosen by a hash of the\n";
+    cout <<
+      "\t\t\t\t  relative path of the subtrees at depth \"k\"\n";
+    cout <<
+      "\t\t\t\t  (--shard-depth=k, default 1; 0: the targets);\n";
+    cout <<
+      "\t --serve=socket         : serves requests to clean (\"clean\" or "
+      "\"pretend\",\n";
+    cout <<
+      "\t\t\t\t  then \"-r\" and the directories, tab separated,\n";
+    cout <<
+      "\t\t\t\t  one request per line) from the UNIX domain\n";
+    cout <<
+      "\t\t\t\t  socket \"socket\", answering in JSON lines;\n";
+    cout <<
+      "\t --record=file          : writes to \"file\" the names, types and "
+      "times\n";
+    cout <<
+      "\t\t\t\t  of the entries seen, and the git indexes read\n";
+    cout <<
+      "\t\t\t\t  (with --anonymize, the names are hashed, keeping\n";
+    cout <<
+      "\t\t\t\t  the extensions, and no index is written);\n";
+    cout <<
+      "\t --replay=file          : cleans, in memory, the tree recorded in "
+      "\"file\"\n";
+    cout <<
+      "\t\t\t\t  by --record (no directory may be given);\n";
+    cout <<
+      "\t --stats[=json]         : prints a summary of the work done on "
+      "every\n";
+    cout <<
+      "\t\t\t\t  device (in JSON, on one line);\n";
+    cout <<
+      "\t --merge-stats [--json] : adds up the JSON summaries of all the "
+      "shards\n";
+    cout <<
+      "\t\t\t\t  of a sweep, read from the files given instead\n";
+    cout <<
+      "\t\t\t\t  of the directories.\n";
     cout <<
       "Notes:\t \"ext\" defaults to \"~\"; -b \"\" avoids the unconditional "
       "cleanup of\n";
     cout <<
-      "\t any special file.\n" << endl;
+      "\t any special file; -i implies -j 1.  The limits given by -j,\n";
+    cout <<
+      "\t --max-ops-per-sec and --adaptive apply to every device on "
+      "its own.\n" << endl;
   }
 }
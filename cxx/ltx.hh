@@ -33,9 +33,5 @@ public:
 // Global variables (declaration)
 
 namespace ltx {
-  extern std::string            progname;
-  extern std::string            trailEd;
-  extern std::string::size_type lTrailEd;
-  extern bool                   confirm;
-  extern bool                   recurse;
+  extern std::string progname;
 }
@@ -0,0 +1,215 @@
+// -------------------------------------------------------------------
+//
+//     Runs liblintex on a synthetic tree held in memory (see
+//     memfs.hh), to measure the engine without the disk in the way.
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+#include "memfs.hh"             // Includes: map, string, vector, ...
+
+extern "C" {
+  #include <time.h>
+  #include <unistd.h>
+  #include <sys/time.h>
+}
+
+using std::cout;
+using std::string;
+
+// Local types
+
+namespace {
+
+  // Counts the decisions, printing nothing
+
+  class counter : public ltx::sink {
+  public:
+    unsigned long count[5];
+
+    counter() { for (int i = 0;  i < 5;  i++) count[i] = 0; }
+    void decide(const ltx::decision & d) { count[d.act]++; }
+  };
+
+  // The shape of the synthetic tree
+
+  struct shape {
+    unsigned depth;             // Levels of subdirectories,
+    unsigned width;             //   so many in every directory,
+    unsigned families;          // each one with so many documents.
+  };
+}
+
+// Local functions (declarations)
+
+namespace {
+  void   build(ltx::memBackend &, const string &, const shape &,
+               unsigned);
+  double now();
+  void   syntax(const char *);
+}
+
+// Code
+
+int main(
+  int   argc,
+  char *argv[]
+) {
+  // Decodes the command line options
+
+  shape         s;
+  ltx::options  opts;
+  double        latency   = 0.0;
+  double        errors    = 0.0;
+  double        stalls    = 0.0;
+  double        stall     = 0.0;
+  unsigned      repeat    = 1;
+  int           c;
+
+  s.depth    = 3;
+  s.width    = 10;
+  s.families = 25;
+
+  opts.recurse = true;
+  opts.pretend = true;
+
+  while ((c = getopt(argc, argv, "d:w:f:j:J:l:e:s:S:t:n:R")) != -1) {
+    switch (c) {
+      case 'd':  s.depth       = std::atoi(optarg);         break;
+      case 'w':  s.width       = std::atoi(optarg);         break;
+      case 'f':  s.families    = std::atoi(optarg);         break;
+      case 'j':  opts.jobs     = std::atoi(optarg);         break;
+      case 'J':  opts.dirJobs  = std::atoi(optarg);         break;
+      case 'l':  latency       = std::atof(optarg) * 1e-6;  break;
+      case 'e':  errors        = std::atof(optarg);         break;
+      case 's':  stalls        = std::atof(optarg);         break;
+      case 'S':  stall         = std::atof(optarg);         break;
+      case 't':  opts.opTimeout = std::atof(optarg);        break;
+      case 'n':  repeat        = std::atoi(optarg);         break;
+      case 'R':  opts.pretend  = false;                     break;
+      default:   syntax(argv[0]);
+    }
+  }
+  if (optind != argc  ||  opts.jobs == 0  ||  opts.dirJobs == 0  ||
+      repeat == 0) syntax(argv[0]);
+
+  for (unsigned run = 0;  run < repeat;  run++) {
+    ltx::memBackend fs;
+
+    build(fs, "/bench", s, 0);
+    fs.latency(latency);
+    fs.errors(errors);
+    fs.stalls(stalls, stall);
+    opts.backend = &fs;
+
+    unsigned long entries = fs.entries();
+    std::list<string> targets(1, "/bench");
+    counter           decisions;
+    ltx::summary      result;
+    ltx::opCounters   all;
+
+    clock_t cpu  = clock();
+    double  wall = now();
+
+    ltx::clean(targets, opts, decisions, result);
+
+    wall = now() - wall;
+    double cpuTime = double(clock() - cpu) / CLOCKS_PER_SEC;
+
+    for (std::vector<ltx::devStats>::const_iterator iter =
+           result.devices.begin();
+         iter != result.devices.end();  iter++) {
+      all += iter->counters;
+    }
+
+    cout << "entries " << entries << ", dirs " << all.dirs
+         << ", read " << all.entries << ", stats " << all.stats
+         << ", errors " << all.errors << ", timeouts " << all.timeouts
+         << '\n'
+         << "removed " << decisions.count[ltx::decision::removed]
+         << ", would remove " << decisions.count[ltx::decision::wouldRemove]
+         << ", kept " << decisions.count[ltx::decision::kept]
+         << ", failed " << decisions.count[ltx::decision::failed]
+         << ", skipped " << decisions.count[ltx::decision::skipped] << '\n'
+         << "wall " << wall << " s, cpu " << cpuTime << " s, "
+         << (wall > 0.0 ? all.entries / wall : 0.0) << " entries/s\n";
+  }
+
+  return 0;
+}
+
+// Local functions (definitions)
+
+namespace {
+  void build(
+    ltx::memBackend & fs,
+    const string    & dir,
+    const shape     & s,
+    unsigned          level
+  ) {
+    // Fills "dir": every family is a TeX source with its outputs (one
+    // of them older than the source, to be kept), a file unrelated to
+    // TeX and an editor backup.
+
+    const time_t base = 1000000000;
+
+    fs.add(dir, true, base);
+
+    for (unsigned i = 0;  i < s.families;  i++) {
+      std::ostringstream os;
+      os << dir << "/doc" << i;
+      string stem = os.str();
+
+      fs.add(stem + ".tex", false, base + 10, 4096);
+      fs.add(stem + ".aux", false, base + 20, 512);
+      fs.add(stem + ".log", false, base + 20, 8192);
+      fs.add(stem + ".dvi", false, base + 20, 16384);
+      fs.add(stem + ".toc", false, base,      256);
+      fs.add(stem + ".txt", false, base + 20, 1024);
+      fs.add(stem + ".tex~", false, base,     4096);
+    }
+
+    if (level < s.depth) {
+      for (unsigned i = 0;  i < s.width;  i++) {
+        std::ostringstream os;
+        os << dir << "/sub" << i;
+        build(fs, os.str(), s, level + 1);
+      }
+    }
+  }
+
+  double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+  }
+
+  void syntax(
+    const char * name
+  ) {
+    std::cerr << "Usage: " << name << " [options]\n"
+      "  -d N    levels of subdirectories (3)\n"
+      "  -w N    subdirectories in every directory (10)\n"
+      "  -f N    documents in every directory (25)\n"
+      "  -j N    scanner threads\n"
+      "  -J N    threads for every directory, when huge\n"
+      "  -l US   latency of every operation, in microseconds\n"
+      "  -e P    probability that an operation fails\n"
+      "  -s P    probability that an operation stalls,\n"
+      "  -S S      for so many seconds\n"
+      "  -t S    give up operations after so many seconds\n"
+      "  -n N    repeat the run so many times\n"
+      "  -R      really remove the files (in memory), not pretend\n";
+    std::exit(1);
+  }
+}
@@ -0,0 +1,370 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <utility>
+#include <cerrno>
+#include <cstring>
+#include "memfs.hh"             // Includes: map, string, vector, ...
+
+extern "C" {
+  #include <time.h>
+}
+
+using std::string;
+
+// Local types
+
+namespace {
+
+  // A directory being listed: its entries are copied when it is
+  // opened, so that removing files meanwhile does no harm.
+
+  class memDir : public ltx::fsDir {
+  private:
+    typedef std::vector< std::pair<string, unsigned> > entryList;
+
+    entryList            _entries;
+    entryList::size_type _next;
+    struct dirent        _de;
+
+  public:
+    memDir() : _next(0) {}
+
+    void add(const string & name, unsigned index, bool isDir) {
+      _entries.push_back(std::make_pair(name, (index << 1) | isDir));
+    }
+    struct dirent * next();
+  };
+
+  void sleep_for(double);
+  void split(const string &, std::vector<string> &);
+}
+
+// Methods for the class memBackend
+
+ltx::memBackend::memBackend()
+  : _entries(0), _latency(0.0), _errors(0.0), _stalls(0.0), _stall(0.0),
+    _random(1)
+{
+  pthread_mutex_init(&_lock, 0);
+  _nodes.push_back(node(0, true, 0, 0, 0));
+}
+
+ltx::memBackend::~memBackend()
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+void ltx::memBackend::add(
+  const string & path,
+  bool           isDir,
+  time_t         mTime,
+  off_t          size,
+  long           mNsec
+) {
+  // Adds "path" (a directory if "isDir"), creating its missing
+  // ancestors; an existing node is just given the new attributes.
+
+  std::vector<string> names;
+  split(path, names);
+
+  pthread_mutex_lock(&_lock);
+
+  unsigned current = 0;
+
+  for (std::vector<string>::size_type i = 0;  i < names.size();  i++) {
+    if (names[i] == "..") {
+      current = _nodes[current].parent;
+      continue;
+    }
+
+    bool last = i + 1 == names.size();
+    std::map<string, unsigned>::iterator where =
+      _nodes[current].children.find(names[i]);
+
+    if (where == _nodes[current].children.end()) {
+      unsigned index = _nodes.size();
+      _nodes.push_back(node(current, last ? isDir : true, mTime,
+                            last ? mNsec : 0, last ? size : 0));
+      _nodes[current].children[names[i]] = index;
+      _entries++;
+      current = index;
+    } else {
+      current = where->second;
+    }
+
+    if (last) {
+      _nodes[current].mTime = mTime;
+      _nodes[current].mNsec = mNsec;
+      _nodes[current].size  = size;
+    }
+  }
+
+  pthread_mutex_unlock(&_lock);
+}
+
+bool ltx::memBackend::setContent(
+  const string & path,
+  const string & data
+) {
+  // Gives the file "path" the content "data" (and its size); false if
+  // there is no such file.
+
+  pthread_mutex_lock(&_lock);
+
+  int  index = lookup(path);
+  bool found = index >= 0  &&  ! _nodes[index].isDir;
+
+  if (found) {
+    _nodes[index].content = data;
+    _nodes[index].size    = data.size();
+  }
+
+  pthread_mutex_unlock(&_lock);
+  return found;
+}
+
+int ltx::memBackend::lookup(
+  const string & path
+) const {
+  // Returns the index of the node "path", or -1 (with errno set);
+  // must be called with the lock held.
+
+  std::vector<string> names;
+  split(path, names);
+
+  unsigned current = 0;
+
+  for (std::vector<string>::const_iterator iter = names.begin();
+       iter != names.end();  iter++) {
+    if (*iter == "..") {
+      current = _nodes[current].parent;
+      continue;
+    }
+
+    if (! _nodes[current].isDir) {
+      errno = ENOTDIR;
+      return -1;
+    }
+
+    std::map<string, unsigned>::const_iterator where =
+      _nodes[current].children.find(*iter);
+
+    if (where == _nodes[current].children.end()) {
+      errno = ENOENT;
+      return -1;
+    }
+    current = where->second;
+  }
+  return static_cast<int>(current);
+}
+
+double ltx::memBackend::draw()
+{
+  // A pseudo-random number in [0, 1), from a 31 bit linear
+  // congruential generator; must be called with the lock held.
+
+  _random = (_random * 1103515245UL + 12345UL) & 0x7fffffffUL;
+  return _random / 2147483648.0;
+}
+
+bool ltx::memBackend::delay()
+{
+  // Waits as an operation would on a slow file system; returns false
+  // if the operation must fail.
+
+  pthread_mutex_lock(&_lock);
+  double wait = _latency;
+  if (_stalls > 0.0  &&  draw() < _stalls) wait += _stall;
+  bool   fail = _errors > 0.0  &&  draw() < _errors;
+  pthread_mutex_unlock(&_lock);
+
+  if (wait > 0.0) sleep_for(wait);
+  if (fail) errno = EIO;
+  return ! fail;
+}
+
+int ltx::memBackend::stat(
+  const string & path,
+  struct stat  * pStat,
+  unsigned
+) {
+  if (! delay()) return -1;
+
+  pthread_mutex_lock(&_lock);
+
+  int index = lookup(path);
+
+  if (index >= 0) {
+    const node & n = _nodes[index];
+
+    std::memset(pStat, 0, sizeof(*pStat));
+    pStat->st_dev          = 1;
+    pStat->st_ino          = index + 1;
+    pStat->st_mode         = n.isDir ? S_IFDIR | 0755 : S_IFREG | 0644;
+    pStat->st_nlink        = 1;
+    pStat->st_size         = n.size;
+    pStat->st_mtim.tv_sec  = n.mTime;
+    pStat->st_mtim.tv_nsec = n.mNsec;
+    pStat->st_ctim         = pStat->st_mtim;
+    pStat->st_atim         = pStat->st_mtim;
+  }
+
+  int err = errno;
+  pthread_mutex_unlock(&_lock);
+  errno = err;
+  return index >= 0 ? 0 : -1;
+}
+
+int ltx::memBackend::remove(
+  const string & path
+) {
+  // Removes a file, or an empty directory, as remove(3) does
+
+  if (! delay()) return -1;
+
+  pthread_mutex_lock(&_lock);
+
+  int index = lookup(path);
+  int err   = errno;
+
+  if (index == 0) {
+    index = -1;
+    err   = EBUSY;
+  } else if (index > 0  &&  ! _nodes[index].children.empty()) {
+    index = -1;
+    err   = ENOTEMPTY;
+  }
+
+  if (index > 0) {
+    node                & parent = _nodes[_nodes[index].parent];
+    std::vector<string>   parts;
+
+    // The entry is found by its name, unless the path ends in ".."
+
+    split(path, parts);
+
+    std::map<string, unsigned>::iterator iter =
+      parent.children.find(parts.back());
+
+    if (iter == parent.children.end()  ||
+        iter->second != static_cast<unsigned>(index)) {
+      for (iter = parent.children.begin();
+           iter != parent.children.end();  iter++) {
+        if (iter->second == static_cast<unsigned>(index)) break;
+      }
+    }
+    if (iter != parent.children.end()) parent.children.erase(iter);
+    _entries--;
+  }
+
+  pthread_mutex_unlock(&_lock);
+  errno = err;
+  return index > 0 ? 0 : -1;
+}
+
+ltx::fsDir * ltx::memBackend::openDir(
+  const string & path
+) {
+  if (! delay()) return 0;
+
+  pthread_mutex_lock(&_lock);
+
+  int      index = lookup(path);
+  int      err   = errno;
+  memDir * pDir  = 0;
+
+  if (index >= 0  &&  ! _nodes[index].isDir) {
+    index = -1;
+    err   = ENOTDIR;
+  }
+
+  if (index >= 0) {
+    const node & n = _nodes[index];
+
+    pDir = new memDir;
+    pDir->add(".",  index,    true);
+    pDir->add("..", n.parent, true);
+    for (std::map<string, unsigned>::const_iterator iter =
+           n.children.begin();
+         iter != n.children.end();  iter++) {
+      pDir->add(iter->first, iter->second, _nodes[iter->second].isDir);
+    }
+  }
+
+  pthread_mutex_unlock(&_lock);
+  errno = err;
+  return pDir;
+}
+
+int ltx::memBackend::readFile(
+  const string & path,
+  string       & content
+) {
+  if (! delay()) return -1;
+
+  pthread_mutex_lock(&_lock);
+
+  int index = lookup(path);
+  int err   = errno;
+
+  if (index >= 0  &&  _nodes[index].isDir) {
+    index = -1;
+    err   = EISDIR;
+  }
+  if (index >= 0) content = _nodes[index].content;
+
+  pthread_mutex_unlock(&_lock);
+  errno = err;
+  return index >= 0 ? 0 : -1;
+}
+
+// Methods for the class memDir
+
+namespace {
+  struct dirent * memDir::next()
+  {
+    if (_next == _entries.size()) return 0;
+
+    const std::pair<string, unsigned> & e = _entries[_next++];
+
+    std::memset(&_de, 0, sizeof(_de));
+    _de.d_ino  = (e.second >> 1) + 1;
+    _de.d_type = (e.second & 1) ? DT_DIR : DT_REG;
+    std::strncpy(_de.d_name, e.first.c_str(), sizeof(_de.d_name) - 1);
+    return &_de;
+  }
+
+  void sleep_for(
+    double seconds
+  ) {
+    struct timespec t;
+    t.tv_sec  = static_cast<time_t>(seconds);
+    t.tv_nsec = static_cast<long>((seconds - t.tv_sec) * 1e9);
+    while (nanosleep(&t, &t) != 0  &&  errno == EINTR) ;
+  }
+
+  void split(
+    const string        & path,
+    std::vector<string> & names
+  ) {
+    // Splits "path" at every slash, dropping the empty components and
+    // the "." ones
+
+    string::size_type start = 0;
+
+    while (start <= path.size()) {
+      string::size_type slash = path.find('/', start);
+      if (slash == string::npos) slash = path.size();
+
+      string name = path.substr(start, slash - start);
+      if (! name.empty()  &&  name != ".") names.push_back(name);
+      start = slash + 1;
+    }
+  }
+}
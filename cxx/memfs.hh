@@ -0,0 +1,93 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef MEMFS_H_
+#define MEMFS_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "fsbackend.hh"         // Includes: string, dirent.h, sys/stat.h
+
+extern "C" {
+  #include <pthread.h>
+  #include <sys/types.h>
+}
+
+// A file system held in memory, to run the engine on synthetic trees
+// (see fsbackend.hh and ltxbench.cxx).
+//
+// The tree is built by add(), which creates the missing ancestors as
+// directories; every node gets an inode number (its index, plus one)
+// and all of them live on device 1.  Paths are taken from the root,
+// whether or not they start with a slash; "." is ignored, ".." goes
+// up.  Files have a modification time (to the nanosecond) and a size;
+// their content is empty, unless given by setContent() (as done by a
+// replay for the files of git repositories, see dump.hh).
+//
+// Every operation may be slowed down by "latency" seconds; it may fail
+// with EIO, at random, with probability "errors"; and may stall for
+// "stall" seconds, with probability "stalls", to simulate a hung
+// network file system (see options::opTimeout).  The random sequence
+// is seeded by setRandom(), so that a run can be repeated exactly (as
+// far as the threads of the engine allow).
+
+namespace ltx {
+
+  class memBackend : public fsBackend {
+  private:
+    struct node {
+      unsigned                        parent;
+      bool                            isDir;
+      time_t                          mTime;
+      long                            mNsec;
+      off_t                           size;
+      std::string                     content;
+      std::map<std::string, unsigned> children;
+
+      node(unsigned p, bool d, time_t t, long n, off_t s)
+        : parent(p), isDir(d), mTime(t), mNsec(n), size(s) {}
+    };
+
+    mutable pthread_mutex_t _lock;
+    std::vector<node>       _nodes;             // The root is the first
+    unsigned long           _entries;
+    double                  _latency;
+    double                  _errors;
+    double                  _stalls;
+    double                  _stall;
+    unsigned long           _random;
+
+    int    lookup(const std::string &) const;
+    bool   delay();
+    double draw();
+
+    memBackend & operator = (const memBackend & rhs);
+    memBackend(const memBackend & rhs);
+
+  public:
+    memBackend();
+    ~memBackend();
+
+    void add(const std::string &, bool, time_t, off_t = 0, long = 0);
+    bool setContent(const std::string &, const std::string &);
+    unsigned long entries() const { return _entries; }
+
+    void latency(double l)            { _latency = l; }
+    void errors(double e)             { _errors = e; }
+    void stalls(double p, double s)   { _stalls = p;  _stall = s; }
+    void setRandom(unsigned long r)   { _random = r; }
+
+    int     stat(const std::string &, struct stat *, unsigned);
+    int     remove(const std::string &);
+    fsDir * openDir(const std::string &);
+    int     readFile(const std::string &, std::string &);
+  };
+}
+
+#endif // MEMFS_H_
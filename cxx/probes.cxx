@@ -0,0 +1,29 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include "probes.hh"            // Includes: time.h
+
+// The semaphores of the probes (see probes.hh), in the section where
+// the tracers look for them
+
+#if defined(LTX_PROBES)
+
+#define LTX_SEMAPHORE(name) \
+  volatile unsigned short ltx_##name##_semaphore \
+    __attribute__((section(".probes"))) = 0
+
+extern "C" {
+  LTX_SEMAPHORE(dir_open);
+  LTX_SEMAPHORE(dir_close);
+  LTX_SEMAPHORE(entry_classified);
+  LTX_SEMAPHORE(family_decided);
+  LTX_SEMAPHORE(unlink_start);
+  LTX_SEMAPHORE(unlink_done);
+}
+
+#endif // LTX_PROBES
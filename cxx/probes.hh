@@ -0,0 +1,95 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef PROBES_H_
+#define PROBES_H_
+
+extern "C" {
+  #include <time.h>
+}
+
+// Static tracepoints (USDT, provider "ltx"), for tracing a live clean
+// with bpftrace, perf or SystemTap:
+//
+//     dir_open         (path)                    a directory was opened,
+//     dir_close        (path, entries, ns)       and has been read;
+//     entry_classified (dir, name, kind)         a file was classified
+//                                                (0: not relevant, 1:
+//                                                .tex, 2: output, 3:
+//                                                editor backup);
+//     family_decided   (dir, basename, members, removed)
+//                                                the outputs of a family
+//                                                have been decided;
+//     unlink_start     (path)                    a file is being removed,
+//     unlink_done      (path, errno, ns)         and has been (errno 0).
+//
+// The times are in nanoseconds.  For example:
+//
+//     bpftrace -e 'usdt:./ltx:ltx:unlink_done { @ns = hist(arg2); }'
+//
+// The probes are built with <sys/sdt.h> (from SystemTap) if it is
+// found, and unless NO_PROBES is defined; otherwise they compile to
+// nothing.  Every probe has a semaphore, raised by the tracer when it
+// attaches: the arguments are computed, and the clock is read, only
+// then.  lintex.c has the same probes, under the provider "lintex".
+
+#if ! defined(NO_PROBES)  &&  defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    define LTX_PROBES 1
+#  endif
+#endif
+
+#if defined(LTX_PROBES)
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+extern "C" {
+  extern volatile unsigned short ltx_dir_open_semaphore;
+  extern volatile unsigned short ltx_dir_close_semaphore;
+  extern volatile unsigned short ltx_entry_classified_semaphore;
+  extern volatile unsigned short ltx_family_decided_semaphore;
+  extern volatile unsigned short ltx_unlink_start_semaphore;
+  extern volatile unsigned short ltx_unlink_done_semaphore;
+}
+
+#define LTX_PROBE_ENABLED(name) \
+  __builtin_expect(ltx_##name##_semaphore != 0, 0)
+
+#define LTX_PROBE1(name, a) \
+  do { if (LTX_PROBE_ENABLED(name)) DTRACE_PROBE1(ltx, name, a); } while (0)
+#define LTX_PROBE3(name, a, b, c) \
+  do { if (LTX_PROBE_ENABLED(name)) DTRACE_PROBE3(ltx, name, a, b, c); } \
+  while (0)
+#define LTX_PROBE4(name, a, b, c, d) \
+  do { if (LTX_PROBE_ENABLED(name)) DTRACE_PROBE4(ltx, name, a, b, c, d); } \
+  while (0)
+
+#else
+
+#define LTX_PROBE_ENABLED(name) 0
+
+#define LTX_PROBE1(name, a)          do { if (0) { (void) (a); } } while (0)
+#define LTX_PROBE3(name, a, b, c) \
+  do { if (0) { (void) (a); (void) (b); (void) (c); } } while (0)
+#define LTX_PROBE4(name, a, b, c, d) \
+  do { if (0) { (void) (a); (void) (b); (void) (c); (void) (d); } } \
+  while (0)
+
+#endif // LTX_PROBES
+
+// The clock of the latencies given to the probes, in nanoseconds
+
+inline unsigned long probe_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+#endif // PROBES_H_
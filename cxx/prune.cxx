@@ -0,0 +1,155 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <fstream>
+#include "prune.hh"             // Includes: bitset, string, vector
+
+using std::string;
+
+// Methods for the class pruneRules
+
+void pruneRules::add(
+  const string & pattern
+) {
+  // Compiles "pattern", adding its chain of states to the automaton
+
+  string::size_type n = pattern.size();
+  while (n > 0  &&  pattern[n-1] == '/') n--;
+  if (n == 0) return;
+
+  _starts.push_back(_states.size());
+
+  for (string::size_type i = 0;  i < n;  i++) {
+    state s;
+    s.star   = false;
+    s.accept = false;
+
+    unsigned char c = pattern[i];
+
+    if (c == '*') {
+      s.chars.set();
+      s.star = true;
+
+    } else if (c == '?') {
+      s.chars.set();
+
+    } else if (c == '[') {
+
+      // A character set; an unterminated one stands for a "["
+
+      string::size_type j = i + 1;
+      bool negate = j < n  &&  (pattern[j] == '!'  ||  pattern[j] == '^');
+      if (negate) j++;
+
+      string::size_type first = j;
+      while (j < n  &&  (pattern[j] != ']'  ||  j == first)) j++;
+
+      if (j >= n) {
+        s.chars.set(c);
+      } else {
+        for (string::size_type k = first;  k < j;  k++) {
+          unsigned char lo = pattern[k], hi = lo;
+          if (k + 2 < j  &&  pattern[k+1] == '-') {
+            hi = pattern[k+2];
+            k += 2;
+          }
+          for (unsigned ch = lo;  ch <= hi;  ch++) s.chars.set(ch);
+        }
+        if (negate) s.chars.flip();
+        i = j;
+      }
+
+    } else {
+      if (c == '\\'  &&  i + 1 < n) c = pattern[++i];
+      s.chars.set(c);
+    }
+
+    _states.push_back(s);
+  }
+
+  state end;
+  end.star   = false;
+  end.accept = true;
+  _states.push_back(end);
+}
+
+bool pruneRules::load(
+  const string & fileName
+) {
+  // Adds the rules in the file "fileName"; returns false if it cannot
+  // be read.
+
+  std::ifstream in(fileName.c_str());
+  if (! in) return false;
+
+  _sources.push_back(fileName);
+
+  string line;
+
+  while (std::getline(in, line)) {
+    string::size_type last = line.find_last_not_of(" \t\r");
+    if (last == string::npos  ||  line[0] == '#') continue;
+    add(line.substr(0, last + 1));
+  }
+
+  return true;
+}
+
+void pruneRules::addClosure(
+  std::vector<unsigned> & set,
+  std::vector<char>     & member,
+  unsigned                s
+) const {
+  // Adds the state "s" to "set", and the states following it as long
+  // as a "*" (which may match nothing) is passed over.
+
+  for (;;) {
+    if (member[s]) return;
+    member[s] = 1;
+    set.push_back(s);
+    if (! _states[s].star) return;
+    s++;
+  }
+}
+
+bool pruneRules::matches(
+  const string & name
+) const {
+  // Runs the automaton over "name", all the patterns at once
+
+  if (_starts.empty()) return false;
+
+  std::vector<unsigned> curr, next;
+  std::vector<char>     inCurr(_states.size(), 0), inNext;
+  std::vector<unsigned>::const_iterator iter;
+
+  for (iter = _starts.begin();  iter != _starts.end();  iter++) {
+    addClosure(curr, inCurr, *iter);
+  }
+
+  for (string::size_type i = 0;  i < name.size()  &&  ! curr.empty();  i++) {
+    unsigned char c = name[i];
+
+    next.clear();
+    inNext.assign(_states.size(), 0);
+
+    for (iter = curr.begin();  iter != curr.end();  iter++) {
+      const state & s = _states[*iter];
+      if (s.accept  ||  ! s.chars.test(c)) continue;
+      addClosure(next, inNext, s.star ? *iter : *iter + 1);
+    }
+
+    curr.swap(next);
+  }
+
+  for (iter = curr.begin();  iter != curr.end();  iter++) {
+    if (_states[*iter].accept) return true;
+  }
+
+  return false;
+}
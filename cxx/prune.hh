@@ -0,0 +1,66 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef PRUNE_H_
+#define PRUNE_H_
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+// Rules pruning the subdirectories that are not worth a scan (.git,
+// node_modules, build caches, ...).
+//
+// A rule is a glob pattern ("*" matches any string, "?" any character,
+// "[...]" and "[!...]" a character set, "\" quotes the next character)
+// compared with the name of a subdirectory, not with its path; a
+// trailing "/" is ignored.  Rules come from the command line and from
+// the ".lintexignore" files (one rule per line, blank lines and lines
+// starting with "#" skipped): those in a directory apply to all its
+// subtree, on top of the inherited ones.
+//
+// All the patterns of a rule set are compiled in a single
+// nondeterministic automaton, which is run once over a name whatever
+// the number of patterns: every pattern is a chain of states, each
+// matching a character set either once or (for "*") any number of
+// times, the last one being accepting.  A set is built by extending
+// the set inherited from the parent directory, and is never changed
+// afterwards: it can be shared by all the threads without locking.
+// The files a set was loaded from are remembered, so that it can be
+// built again (see checkpoint.hh).
+
+class pruneRules {
+private:
+  struct state {
+    std::bitset<256> chars;     // Characters matched,
+    bool             star;      //   any number of times,
+    bool             accept;    // or end of a pattern.
+  };
+
+  std::vector<state>       _states;
+  std::vector<unsigned>    _starts;
+  std::vector<std::string> _sources;    // Files loaded, in order
+
+  void addClosure(std::vector<unsigned> &, std::vector<char> &,
+                  unsigned) const;
+
+public:
+  pruneRules() {}
+  pruneRules(const pruneRules & parent) :
+    _states(parent._states), _starts(parent._starts),
+    _sources(parent._sources) {}
+
+  void add(const std::string &);
+  bool load(const std::string &);
+
+  bool empty()                           const { return _starts.empty(); }
+  const std::vector<std::string> & sources() const { return _sources; }
+  bool matches(const std::string &)      const;
+};
+
+#endif // PRUNE_H_
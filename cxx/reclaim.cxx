@@ -0,0 +1,165 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include <functional>
+#include <cerrno>
+#include <cstring>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "reclaim.hh"           // Includes: map, queue, string, ...
+
+extern "C" {
+  #include <sys/stat.h>
+}
+
+using std::string;
+using ltx::decision;
+
+// Local variables
+
+namespace {
+  const double blockSize = 512.0;       // Unit of st_blocks
+  const char   notNeeded[] = "not needed for the space to reclaim";
+}
+
+// Methods for the class reclaimer
+
+reclaimer::reclaimer(
+  double budget
+) : _budget(budget), _held(0.0)
+{
+  pthread_mutex_init(&_lock, 0);
+}
+
+reclaimer::~reclaimer()
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+void reclaimer::offer(
+  runContext        & ctx,
+  const string      & path,
+  const struct stat & sStat
+) {
+  // Takes the file "path" as a candidate for removal
+
+  candidate c;
+  c.bytes  = sStat.st_blocks * blockSize;
+  c.nLinks = sStat.st_nlink;
+  c.paths.push_back(path);
+
+  pthread_mutex_lock(&_lock);
+
+  if (c.nLinks <= 1) {
+    push(ctx, c);
+
+  } else {
+    inodeId     id(sStat.st_dev, sStat.st_ino);
+    candidate & group = _linked[id];
+
+    if (group.paths.empty()) {
+      group = c;
+    } else {
+      group.paths.push_back(path);
+    }
+
+    if (group.paths.size() >= group.nLinks) {
+      push(ctx, group);
+      _linked.erase(id);
+    }
+  }
+
+  pthread_mutex_unlock(&_lock);
+}
+
+void reclaimer::push(
+  runContext      & ctx,
+  const candidate & c
+) {
+  // Adds "c" to the heap, then drops the smallest candidates while
+  // the others are enough; called with the lock held.
+
+  _heap.push(c);
+  _held += c.bytes;
+
+  while (_heap.size() > 1  &&
+         (_held - _heap.top().bytes >= _budget  ||
+          _heap.size() > maxCandidates)) {
+    const candidate & smallest = _heap.top();
+
+    for (std::vector<string>::const_iterator iter = smallest.paths.begin();
+         iter != smallest.paths.end();  iter++) {
+      ctx.report(*iter, decision::kept, notNeeded);
+    }
+
+    _held -= smallest.bytes;
+    _heap.pop();
+  }
+}
+
+double reclaimer::finish(
+  runContext & ctx
+) {
+  // Removes the candidates, largest first, until the budget is met;
+  // returns the bytes freed (or that would be freed, if pretending).
+
+  std::vector<candidate> all;
+  double                 freed = 0.0;
+
+  for (std::map<inodeId, candidate>::const_iterator iter = _linked.begin();
+       iter != _linked.end();  iter++) {
+    for (std::vector<string>::const_iterator jter =
+           iter->second.paths.begin();
+         jter != iter->second.paths.end();  jter++) {
+      ctx.report(*jter, decision::kept,
+                 "has other links, removing it frees nothing");
+    }
+  }
+  _linked.clear();
+
+  for (all.reserve(_heap.size());  ! _heap.empty();  _heap.pop()) {
+    all.push_back(_heap.top());
+  }
+  std::reverse(all.begin(), all.end());
+
+  for (std::vector<candidate>::const_iterator iter = all.begin();
+       iter != all.end();  iter++) {
+    std::vector<string>::const_iterator jter;
+
+    if (freed >= _budget  ||  fs_stuck()) {
+      for (jter = iter->paths.begin();  jter != iter->paths.end();  jter++) {
+        ctx.report(*jter, decision::kept, notNeeded);
+      }
+      continue;
+    }
+
+    // All the links of a file must go for its space to be freed
+
+    bool removed = true;
+
+    for (jter = iter->paths.begin();  jter != iter->paths.end();  jter++) {
+      double bytes = jter == iter->paths.begin() ? iter->bytes : 0.0;
+
+      if (ctx.opts.pretend) {
+        ctx.report(*jter, decision::wouldRemove, "", bytes);
+      } else if (fs_remove(*jter) == 0) {
+        ctx.report(*jter, decision::removed, "", bytes);
+      } else {
+        removed = false;
+        if (! fs_stuck()) {
+          ctx.report(*jter, decision::failed, std::strerror(errno));
+        }
+      }
+    }
+
+    if (removed) freed += iter->bytes;
+  }
+
+  return freed;
+}
@@ -0,0 +1,81 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef RECLAIM_H_
+#define RECLAIM_H_
+
+#include <map>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  #include <pthread.h>
+  #include <sys/types.h>
+}
+
+class runContext;
+
+// Space reclaim: freeing a given number of bytes as fast as possible,
+// removing the largest files first.
+//
+// While scanning, the files that would be removed are offered to the
+// reclaimer instead, with the space they hold (st_blocks, in bytes)
+// and their link count.  A file having more than one link frees its
+// space only when its last link goes: the links found are grouped by
+// inode, and a group becomes a candidate only when all its links have
+// been found, holding the space once.
+//
+// The candidates are kept in a min-heap, whose smallest elements are
+// dropped (and reported as kept) as soon as the others hold the whole
+// budget: the heap never holds more than needed, whatever the size of
+// the scan (and never more than "maxCandidates" elements).  At the end,
+// finish() removes the candidates largest first, stopping when the
+// budget is met, and returns the bytes actually freed.
+//
+// The sizes are kept as double, C++98 having no long long.
+
+class reclaimer {
+private:
+  typedef std::pair<dev_t, ino_t> inodeId;
+
+  struct candidate {
+    double                   bytes;
+    std::vector<std::string> paths;     // All the links of the file
+    nlink_t                  nLinks;
+
+    bool operator > (const candidate & rhs) const {
+      return bytes > rhs.bytes; }
+  };
+
+  typedef std::priority_queue<candidate, std::vector<candidate>,
+                              std::greater<candidate> > minHeap;
+
+  static const std::vector<candidate>::size_type maxCandidates = 1 << 20;
+
+  pthread_mutex_t              _lock;
+  double                       _budget;
+  double                       _held;           // Bytes in the heap
+  minHeap                      _heap;
+  std::map<inodeId, candidate> _linked;         // Links still missing
+
+  void push(runContext &, const candidate &);
+
+  reclaimer & operator = (const reclaimer & rhs);
+  reclaimer(const reclaimer & rhs);
+
+public:
+  reclaimer(double budget);
+  ~reclaimer();
+
+  void   offer(runContext &, const std::string &, const struct stat &);
+  double finish(runContext &);
+};
+
+#endif // RECLAIM_H_
@@ -0,0 +1,240 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include <fstream>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "cleanup.hh"           // Includes: string, file.hh, gitindex.hh
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "recorder.hh"          // Includes: string, vector
+
+using std::string;
+using std::vector;
+using ltx::decision;
+
+// Local variables
+
+namespace {
+  const string tex(".tex");
+  const string fls(".fls");
+  const string fdb(".fdb_latexmk");
+}
+
+// Local functions (declarations)
+
+namespace {
+  string real_dir(const string &);
+  bool   relative_to(const string &, const string &, string &);
+  bool   strip_dir(const string &, string &);
+  bool   read_fls(const string &, const string &, vector<string> &);
+  bool   read_fdb(const string &, const string &, vector<string> &);
+}
+
+// Code
+
+bool read_recorder(
+  const string   & dir,
+  const string   & texName,
+  vector<string> & outputs
+) {
+  string base    = texName.substr(0, texName.size() - tex.size());
+  string realDir = real_dir(dir);
+
+  if (! read_fls(dir + base + fls, realDir, outputs)  &&
+      ! read_fdb(dir + base + fdb, realDir, outputs)) return false;
+
+  std::sort(outputs.begin(), outputs.end());
+  outputs.erase(std::unique(outputs.begin(), outputs.end()), outputs.end());
+  return true;
+}
+
+void clean_recorded(
+  runContext     & ctx,
+  const string   & dir,
+  const string   & texName,
+  const gitScope & git
+) {
+  // Removes the outputs recorded for "dir" + "texName" that are newer
+  // than it; "dir" is empty or ends with a "/".
+
+  struct stat    sStat;
+  vector<string> outputs;
+  string         texPath = dir + texName;
+
+  if (fs_stat(texPath, &sStat) != 0) {
+    if (! fs_stuck()) {
+      ctx.report(texPath, decision::skipped,
+                 string("error calling stat: ") + std::strerror(errno));
+    }
+    return;
+  }
+
+  fileTime texMtime(sStat.st_mtim);
+
+  if (! read_recorder(dir, texName, outputs)) return;
+
+  for (vector<string>::const_iterator iter = outputs.begin();
+       iter != outputs.end()  &&  ! fs_stuck();  iter++) {
+    string path = dir + *iter;
+
+    if (*iter == texName) continue;
+    if (fs_stat(path, &sStat) != 0  ||  S_ISDIR(sStat.st_mode)) continue;
+
+    string::size_type where = ctx.exts.split(*iter);
+
+    if (where != string::npos  &&  ctx.exts.keep(iter->substr(where))) {
+      ctx.report(path, decision::kept,
+                 iter->substr(where) + " files are kept");
+
+    } else if (fileTime(sStat.st_mtim) > texMtime) {
+      if (ctx.opts.confirm  &&  ! ctx.confirm(path)) continue;
+      nuke(ctx, dir, *iter, git);
+
+    } else {
+      ctx.report(path, decision::kept, texName + " is newer");
+    }
+  }
+}
+
+namespace {
+  string real_dir(
+    const string & dir
+  ) {
+    // The canonical absolute path of "dir" (empty: the current one)
+
+    char   resolved[PATH_MAX];
+    string name = dir.empty() ? "." : dir;
+
+    return realpath(name.c_str(), resolved) ? resolved : "";
+  }
+
+  bool relative_to(
+    const string & realDir,
+    const string & path,
+    string       & relative
+  ) {
+    // Sets "relative" to "path" (an absolute path, or a path relative
+    // to "realDir") relative to "realDir"; returns false if "path" is
+    // outside of "realDir", or cannot be said to be inside it.  The
+    // directory holding "path" is resolved first: a symbolic link on
+    // the way could lead anywhere.
+
+    string p = path;
+
+    if (p.empty()  ||  realDir.empty()) return false;
+
+    if (p[0] == '/'  &&  ! strip_dir(realDir, p)) return false;
+
+    while (p.compare(0, 2, "./") == 0) p.erase(0, 2);
+
+    if (p.empty()  ||  p == ".."  ||  p.compare(0, 3, "../") == 0  ||
+        p.find("/../") != string::npos) return false;
+
+    string::size_type slash = p.rfind('/');
+
+    if (slash != string::npos) {
+      char   resolved[PATH_MAX];
+      string parent = realDir + "/" + p.substr(0, slash);
+
+      if (realpath(parent.c_str(), resolved) == 0) return false;
+
+      string dir = resolved;
+      if (! strip_dir(realDir, dir)) return false;
+      p = dir + p.substr(slash);
+    }
+
+    relative = p;
+    return true;
+  }
+
+  bool strip_dir(
+    const string & realDir,
+    string       & path
+  ) {
+    // Removes "realDir" and the following slash from the start of the
+    // absolute "path"; returns false if "path" is not below "realDir".
+
+    string::size_type length = realDir == "/" ? 0 : realDir.size();
+
+    if (path.size() <= length + 1  ||
+        path.compare(0, length, realDir, 0, length) != 0  ||
+        path[length] != '/') return false;
+
+    path.erase(0, length + 1);
+    return true;
+  }
+
+  bool read_fls(
+    const string   & flsName,
+    const string   & realDir,
+    vector<string> & outputs
+  ) {
+    // Lines are "PWD <dir>", "INPUT <file>" or "OUTPUT <file>"
+
+    std::ifstream in(flsName.c_str());
+    if (! in) return false;
+
+    string line, pwd = realDir, relative;
+
+    while (std::getline(in, line)) {
+      if (! line.empty()  &&  line[line.size()-1] == '\r') {
+        line.erase(line.size() - 1);
+      }
+
+      if (line.compare(0, 4, "PWD ") == 0) {
+        pwd = line.substr(4);
+
+      } else if (line.compare(0, 7, "OUTPUT ") == 0) {
+        string out = line.substr(7);
+        if (out.empty()) continue;
+        if (out[0] != '/') out = pwd + "/" + out;
+        if (relative_to(realDir, out, relative)) outputs.push_back(relative);
+      }
+    }
+
+    return true;
+  }
+
+  bool read_fdb(
+    const string   & fdbName,
+    const string   & realDir,
+    vector<string> & outputs
+  ) {
+    // Every rule starts with a line "["rule"] ...", followed by its
+    // source files, then by "(generated)" and the quoted names of the
+    // generated files, then possibly by other parenthesized lists.
+
+    std::ifstream in(fdbName.c_str());
+    if (! in) return false;
+
+    string line, relative;
+    bool   generated = false;
+
+    while (std::getline(in, line)) {
+      string::size_type first = line.find_first_not_of(" \t");
+      if (first == string::npos) continue;
+
+      if (line[first] == '['  ||  line[first] == '(') {
+        generated = line.compare(first, 11, "(generated)") == 0;
+
+      } else if (generated  &&  line[first] == '"') {
+        string::size_type last = line.find('"', first + 1);
+        if (last == string::npos) continue;
+
+        string out = line.substr(first + 1, last - first - 1);
+        if (relative_to(realDir, out, relative)) outputs.push_back(relative);
+      }
+    }
+
+    return true;
+  }
+}
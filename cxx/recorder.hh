@@ -0,0 +1,42 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <string>
+#include <vector>
+
+struct gitScope;
+class runContext;
+
+// Cleaning driven by the recorder files of a build.
+//
+// "tex -recorder" writes, beside "X.tex", a file "X.fls" listing all
+// the files read (INPUT) and written (OUTPUT) by the run, the relative
+// paths being relative to the working directory given by the PWD line;
+// latexmk writes "X.fdb_latexmk", listing for every rule the files it
+// generated (after a "(generated)" line).  These are exactly the
+// files to be cleaned: clean_recorded() reads the recorder file of
+// "X.tex" (.fls first), and removes the recorded outputs that are
+// newer than "X.tex", with no need to read the directory or to know
+// their extensions.  Outputs outside the directory of "X.tex" (or of
+// its subdirectories) are never touched, nor is any file whose
+// extension is one to keep (see exttable.hh) or that is tracked by
+// git (see gitindex.hh).
+//
+// read_recorder() puts in "outputs" the paths of the outputs recorded
+// for "dir" + "texName", relative to "dir" and without duplicates;
+// returns false if there is no recorder file.
+
+bool read_recorder(const std::string &, const std::string &,
+                   std::vector<std::string> &);
+void clean_recorded(runContext &, const std::string &, const std::string &,
+                    const gitScope &);
+
+#endif // RECORDER_H_
@@ -0,0 +1,218 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <vector>
+#include "report.hh"            // Includes: iosfwd, list, map, set, ...
+
+using std::string;
+using ltx::decision;
+
+// Local types and functions (declarations)
+
+namespace {
+  typedef std::pair<double, string> sizedPath;
+
+  string parent_of(const string &);
+  string strip_slash(const string &);
+  string human(double);
+}
+
+// Methods for the class spaceReport
+
+spaceReport::spaceReport(
+  const std::list<string> & roots,
+  ltx::sink               & errors
+) : _errors(errors)
+{
+  for (std::list<string>::const_iterator iter = roots.begin();
+       iter != roots.end();  iter++) {
+    _roots.insert(strip_slash(*iter));
+  }
+}
+
+void spaceReport::decide(
+  const decision & d
+) {
+  switch (d.act) {
+    case decision::removed:
+    case decision::wouldRemove: {
+      total & t = _dirs[parent_of(d.path)];
+      t.files++;
+      t.bytes += d.bytes;
+      break;
+    }
+
+    case decision::kept:
+      break;
+
+    case decision::failed:
+    case decision::skipped:
+      _errors.decide(d);
+      break;
+  }
+}
+
+void spaceReport::print(
+  std::ostream & os,
+  unsigned       top,
+  bool           json
+) const {
+  // Adds the totals of every directory to its ancestors, up to the
+  // targets: the directories are taken deepest first, so that every
+  // subtree is complete when added to its parent.
+
+  std::map<string, total> subtree(_dirs);
+  std::vector< std::pair<long, string> > byDepth;
+  std::map<string, total>::const_iterator iter;
+
+  for (iter = _dirs.begin();  iter != _dirs.end();  iter++) {
+    string dir = iter->first;
+
+    while (_roots.count(dir) == 0) {
+      string up = parent_of(dir);
+      if (up == dir) break;
+      dir = up;
+      subtree[dir];
+    }
+  }
+
+  for (iter = subtree.begin();  iter != subtree.end();  iter++) {
+    byDepth.push_back(std::make_pair(
+      -static_cast<long>(std::count(iter->first.begin(),
+                                    iter->first.end(), '/')),
+      iter->first));
+  }
+  std::sort(byDepth.begin(), byDepth.end());
+
+  total all;
+
+  for (std::vector< std::pair<long, string> >::const_iterator
+         jter = byDepth.begin();  jter != byDepth.end();  jter++) {
+    const string & dir = jter->second;
+    const total  & t   = _dirs.count(dir) ? _dirs.find(dir)->second : total();
+    string         up  = parent_of(dir);
+
+    all.files += t.files;
+    all.bytes += t.bytes;
+
+    if (_roots.count(dir) == 0  &&  up != dir) {
+      subtree[up].files += subtree[dir].files;
+      subtree[up].bytes += subtree[dir].bytes;
+    }
+  }
+
+  // The "top" subtrees holding the most bytes
+
+  std::vector<sizedPath> sizes;
+
+  for (iter = subtree.begin();  iter != subtree.end();  iter++) {
+    sizes.push_back(sizedPath(-iter->second.bytes, iter->first));
+  }
+  std::sort(sizes.begin(), sizes.end());
+  if (top > 0  &&  sizes.size() > top) sizes.resize(top);
+
+  std::ios::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(0);
+
+  if (json) {
+    os << "{\"subtrees\": [";
+    for (std::vector<sizedPath>::const_iterator jter = sizes.begin();
+         jter != sizes.end();  jter++) {
+      const total & t = subtree.find(jter->second)->second;
+      os << (jter == sizes.begin() ? "\n" : ",\n")
+         << "  {\"path\": " << json_string(jter->second)
+         << ", \"files\": " << t.files << ", \"bytes\": " << t.bytes << '}';
+    }
+    os << "\n], \"files\": " << all.files << ", \"bytes\": " << all.bytes
+       << "}\n";
+
+  } else {
+    os << std::setw(8) << "Size" << std::setw(9) << "Files" << "  Subtree\n";
+    for (std::vector<sizedPath>::const_iterator jter = sizes.begin();
+         jter != sizes.end();  jter++) {
+      const total & t = subtree.find(jter->second)->second;
+      os << std::setw(8) << human(t.bytes) << std::setw(9) << t.files
+         << "  " << jter->second << '\n';
+    }
+    os << std::setw(8) << human(all.bytes) << std::setw(9) << all.files
+       << "  (total)\n";
+  }
+
+  os.flags(flags);
+}
+
+namespace {
+  string parent_of(
+    const string & path
+  ) {
+    // The directory holding "path" ("." if none; "/" is its own)
+
+    string::size_type slash = path.rfind('/');
+
+    if (slash == string::npos) return path == "." ? path : ".";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+  }
+
+  string strip_slash(
+    const string & path
+  ) {
+    string::size_type last = path.find_last_not_of('/');
+    return last == string::npos ? (path.empty() ? "." : "/")
+                                : path.substr(0, last + 1);
+  }
+
+  string human(
+    double bytes
+  ) {
+    // "bytes" with a binary suffix, as "du -h" does
+
+    const char * suffixes = "BKMGTP";
+    unsigned     i        = 0;
+
+    while (bytes >= 1024.0  &&  suffixes[i+1] != '\0') {
+      bytes /= 1024.0;
+      i++;
+    }
+
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(i > 0  &&  bytes < 10.0 ? 1 : 0)
+       << bytes << suffixes[i];
+    return os.str();
+  }
+}
+
+string json_string(
+  const string & s
+) {
+  // "s" as a JSON string, quotes included
+
+  string out("\"");
+
+  for (string::const_iterator iter = s.begin();  iter != s.end();  iter++) {
+    unsigned char c = *iter;
+
+    if (c == '"'  ||  c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      static const char hex[] = "0123456789abcdef";
+      out += "\\u00";
+      out += hex[c >> 4];
+      out += hex[c & 0xf];
+    } else {
+      out += c;
+    }
+  }
+
+  return out + '"';
+}
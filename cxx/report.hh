@@ -0,0 +1,54 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef REPORT_H_
+#define REPORT_H_
+
+#include <iosfwd>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+
+// The sink of "ltx --report": where the reclaimable space is.
+//
+// The clean runs pretending, measuring the space of the files that
+// would be removed (see ltx::options); every such file is accounted
+// to its directory, and at the end the totals are added bottom-up to
+// every ancestor, up to the targets, so that every directory gets the
+// number of files and bytes reclaimable in its subtree (a file with
+// more than one link is counted on every link, as "du -l" does).
+// The subtrees holding the most bytes are printed, as a table or in
+// JSON (json_string() quotes a path for it, and is used by the other
+// JSON writers of the front end too); the errors are handed to another
+// sink.
+
+class spaceReport : public ltx::sink {
+private:
+  struct total {
+    unsigned long files;
+    double        bytes;
+
+    total() : files(0), bytes(0.0) {}
+  };
+
+  ltx::sink                    & _errors;
+  std::set<std::string>          _roots;
+  std::map<std::string, total>   _dirs;
+
+public:
+  spaceReport(const std::list<std::string> &, ltx::sink &);
+
+  void decide(const ltx::decision &);
+  void print(std::ostream &, unsigned, bool) const;
+};
+
+std::string json_string(const std::string &);
+
+#endif // REPORT_H_
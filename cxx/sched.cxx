@@ -0,0 +1,437 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <cerrno>
+#include <cmath>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "sched.hh"             // Includes: list, string, vector, ...
+#include "checkpoint.hh"        // Includes: string, utility, vector, ...
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "throttle.hh"          // Includes: pthread.h
+
+using std::string;
+using ltx::devStats;
+using ltx::opCounters;
+using ltx::pfCounters;
+
+extern "C" {
+  #include <sys/time.h>
+}
+
+// Local types
+
+namespace {
+  // State of a directory with respect to the prefetcher: absent from
+  // the map if never considered.
+
+  enum pfState { pfRunning, pfDone };
+
+  struct runState;
+
+  // A device, with its queue and the threads serving it (plus, if
+  // "options::prefetch" is positive, the thread warming the caches for
+  // the next directories in the queue).  All the fields but "throttle"
+  // are protected by the lock of the run.
+
+  struct devPool {
+    runState               & run;
+    dev_t                    dev;
+    std::deque<dirTask>      pending;
+    pthread_cond_t           ready;
+    pthread_cond_t           pfReady;
+    std::vector<pthread_t>   threads;
+    pthread_t                prefetcher;
+    std::map<string,pfState> prefetched;
+    opThrottle               throttle;
+    opCounters               totals;
+    pfCounters               pf;
+    double                   first;
+    double                   last;
+
+    devPool(runState &, dev_t);
+    ~devPool() {
+      pthread_cond_destroy(&pfReady);
+      pthread_cond_destroy(&ready);
+    }
+  };
+
+  typedef std::map<dev_t, devPool *> poolMap;
+
+  // The state of a run.  "outstanding" counts the directories queued
+  // or being scanned, on all the devices: when it drops to zero the
+  // run is over.  If the run is checkpointed, the directories being
+  // scanned are in "running", those completed since the last
+  // checkpoint in "done", and those that timed out in "stuck" (they
+  // stay in the frontier, to be tried again on resume).
+
+  typedef std::map<unsigned long, dirTask> taskMap;
+
+  struct runState {
+    runContext      & ctx;
+    scanFunction      scanner;
+    checkpoint      * ckpt;
+    poolMap           pools;
+    unsigned long     outstanding;
+    taskMap           running;
+    unsigned long     nextId;
+    std::vector<checkpoint::dirId>
+                      done;
+    std::vector<dirTask>
+                      stuck;
+    pthread_mutex_t   lock;
+    pthread_cond_t    doneCond;
+
+    runState(runContext & c, scanFunction s, checkpoint * k)
+      : ctx(c), scanner(s), ckpt(k), outstanding(0), nextId(0) {
+      pthread_mutex_init(&lock, 0);
+      pthread_cond_init(&doneCond, 0);
+    }
+    ~runState() {
+      pthread_cond_destroy(&doneCond);
+      pthread_mutex_destroy(&lock);
+    }
+  };
+
+  devPool::devPool(
+    runState & r,
+    dev_t      d
+  ) : run(r), dev(d),
+      throttle(r.ctx.opts.maxOpsPerSec,
+               r.ctx.opts.jobs * std::max(1U, r.ctx.opts.dirJobs),
+               r.ctx.opts.adaptive, r.ctx.opts.targetLatency),
+      first(0.0), last(0.0)
+  {
+    pthread_cond_init(&ready, 0);
+    pthread_cond_init(&pfReady, 0);
+  }
+}
+
+// Local functions (declarations)
+
+namespace {
+  devPool * get_pool(runState &, dev_t);
+  void      wake_all(runState &);
+  void    * worker(void *);
+  void    * prefetcher(void *);
+  void    * checkpointer(void *);
+}
+
+// Code
+
+void sched_run(
+  runContext              & ctx,
+  const taskList          & roots,
+  scanFunction              scan,
+  std::vector<devStats>   & stats,
+  checkpoint              * ckpt
+) {
+  // Scans all the directories in "roots" (and those returned by
+  // "scan"), then fills "stats" with a summary for every device.
+
+  runState  run(ctx, scan, ckpt);
+  pthread_t saver;
+
+  pthread_mutex_lock(&run.lock);
+
+  for (taskList::const_iterator iter = roots.begin();
+       iter != roots.end();  iter++) {
+    get_pool(run, iter->dev)->pending.push_back(*iter);
+    run.outstanding++;
+  }
+  wake_all(run);
+
+  if (ckpt) pthread_create(&saver, 0, checkpointer, &run);
+
+  while (run.outstanding > 0) pthread_cond_wait(&run.doneCond, &run.lock);
+
+  pthread_mutex_unlock(&run.lock);
+
+  // The sweep is over: the checkpoint is removed, unless some
+  // directory timed out; then just those are left in it.
+
+  if (ckpt) {
+    pthread_join(saver, 0);
+
+    string error;
+
+    if (run.stuck.empty()) {
+      ckpt->finish();
+    } else if (! ckpt->save(run.stuck, run.done, error)) {
+      ctx.report(ctx.opts.checkpoint, ltx::decision::skipped, error);
+    }
+  }
+
+  // No pool may be created any more: joins all the threads, then
+  // builds the summaries.
+
+  stats.clear();
+
+  for (poolMap::iterator iter = run.pools.begin();
+       iter != run.pools.end();  iter++) {
+    devPool & p = *iter->second;
+
+    for (std::vector<pthread_t>::iterator jter = p.threads.begin();
+         jter != p.threads.end();  jter++) {
+      pthread_join(*jter, 0);
+    }
+    if (ctx.opts.prefetch > 0) pthread_join(p.prefetcher, 0);
+
+    devStats s;
+    s.dev         = p.dev;
+    s.counters    = p.totals;
+    s.ops         = p.throttle.operations();
+    s.meanLatency = p.throttle.meanLatency();
+    s.elapsed     = p.last - p.first;
+    s.prefetch    = p.pf;
+    stats.push_back(s);
+
+    delete iter->second;
+  }
+}
+
+namespace {
+  devPool * get_pool(
+    runState & run,
+    dev_t      dev
+  ) {
+    // Returns the pool of the device "dev", creating it (and starting
+    // its threads) if needed.  Must be called with the lock held.
+
+    poolMap::iterator iter = run.pools.find(dev);
+    if (iter != run.pools.end()) return iter->second;
+
+    const ltx::options & opts  = run.ctx.opts;
+    devPool            * pPool = new devPool(run, dev);
+    run.pools[dev] = pPool;
+
+    pPool->threads.resize(opts.jobs > 0 ? opts.jobs : 1);
+    for (std::vector<pthread_t>::iterator jter = pPool->threads.begin();
+         jter != pPool->threads.end();  jter++) {
+      pthread_create(&*jter, 0, worker, pPool);
+    }
+    if (opts.prefetch > 0) {
+      pthread_create(&pPool->prefetcher, 0, prefetcher, pPool);
+    }
+    return pPool;
+  }
+
+  void wake_all(
+    runState & run
+  ) {
+    // Wakes up every thread; must be called with the lock held.
+
+    for (poolMap::iterator iter = run.pools.begin();
+         iter != run.pools.end();  iter++) {
+      pthread_cond_broadcast(&iter->second->ready);
+      pthread_cond_broadcast(&iter->second->pfReady);
+    }
+    pthread_cond_broadcast(&run.doneCond);
+  }
+
+  void * worker(
+    void * arg
+  ) {
+    // Body of a scanner thread serving the pool "arg": takes the next
+    // directory from the queue, scans it and dispatches the
+    // subdirectories found to the pools of their devices.  The thread
+    // exits when no directory is outstanding on any device.
+
+    devPool    & p   = *static_cast<devPool *>(arg);
+    runState   & run = p.run;
+    opCounters   mine;
+
+    fsops_bind(&run.ctx, &p.throttle, &mine);
+
+    pthread_mutex_lock(&run.lock);
+
+    for (;;) {
+      while (p.pending.empty()  &&  run.outstanding > 0) {
+        pthread_cond_wait(&p.ready, &run.lock);
+      }
+      if (p.pending.empty()) break;
+
+      dirTask task = p.pending.front();
+      p.pending.pop_front();
+      if (p.first == 0.0) p.first = mono_time();
+
+      unsigned long id = run.nextId++;
+      if (run.ckpt) run.running.insert(std::make_pair(id, task));
+
+      if (run.ctx.opts.prefetch > 0) {
+        std::map<string,pfState>::iterator pf =
+          p.prefetched.find(task.name);
+
+        if (pf == p.prefetched.end()) {
+          p.pf.misses++;
+        } else {
+          if (pf->second == pfDone) p.pf.hits++;
+          else                      p.pf.late++;
+          p.prefetched.erase(pf);
+        }
+
+        // The lookahead window has moved forward
+
+        pthread_cond_signal(&p.pfReady);
+      }
+      pthread_mutex_unlock(&run.lock);
+
+      taskList subDirs;
+      run.scanner(run.ctx, task, subDirs);
+
+      pthread_mutex_lock(&run.lock);
+      p.last = mono_time();
+
+      if (run.ckpt) {
+        run.running.erase(id);
+        if (fs_stuck()) {
+          run.stuck.push_back(task);
+        } else {
+          run.done.push_back(checkpoint::dirId(task.dev, task.ino));
+        }
+      }
+
+      for (taskList::reverse_iterator iter = subDirs.rbegin();
+           iter != subDirs.rend();  iter++) {
+        devPool * pTo = get_pool(run, iter->dev);
+        pTo->pending.push_front(*iter);
+        pthread_cond_signal(&pTo->ready);
+        pthread_cond_signal(&pTo->pfReady);
+      }
+
+      run.outstanding += subDirs.size();
+      if (--run.outstanding == 0) wake_all(run);
+    }
+
+    p.totals += mine;
+    pthread_mutex_unlock(&run.lock);
+
+    fsops_bind(0, 0, 0);
+    return 0;
+  }
+
+  void * prefetcher(
+    void * arg
+  ) {
+    // Body of the prefetch thread of the pool "arg": looks for the
+    // first directory, among the next "options::prefetch" in the
+    // queue, that has not been prefetched yet, and warms the caches
+    // for it.  A directory taken by a scanner thread while being
+    // prefetched is simply forgotten.
+
+    devPool    & p     = *static_cast<devPool *>(arg);
+    runState   & run   = p.run;
+    unsigned     ahead = run.ctx.opts.prefetch;
+    opCounters   mine;
+
+    fsops_bind(&run.ctx, &p.throttle, &mine);
+
+    pthread_mutex_lock(&run.lock);
+
+    for (;;) {
+      string next;
+
+      while (run.outstanding > 0) {
+        std::deque<dirTask>::const_iterator iter = p.pending.begin();
+
+        for (unsigned i = 0;
+             i < ahead  &&  iter != p.pending.end();  i++, iter++) {
+          if (p.prefetched.find(iter->name) == p.prefetched.end()) {
+            next = iter->name;
+            break;
+          }
+        }
+        if (! next.empty()) break;
+        pthread_cond_wait(&p.pfReady, &run.lock);
+      }
+      if (run.outstanding == 0) break;
+
+      p.prefetched[next] = pfRunning;
+      p.pf.issued++;
+      pthread_mutex_unlock(&run.lock);
+
+      fs_prefetch(next);
+
+      pthread_mutex_lock(&run.lock);
+      std::map<string,pfState>::iterator pf = p.prefetched.find(next);
+      if (pf != p.prefetched.end()) pf->second = pfDone;
+    }
+
+    pthread_mutex_unlock(&run.lock);
+
+    fsops_bind(0, 0, 0);
+    return 0;
+  }
+
+  void * checkpointer(
+    void * arg
+  ) {
+    // Body of the checkpoint thread of the run "arg": every
+    // "options::checkpointEvery" seconds takes a snapshot of the
+    // frontier (the directories being scanned, then those queued, then
+    // those that timed out) and of the directories completed meanwhile,
+    // and saves it releasing the lock.
+
+    runState & run   = *static_cast<runState *>(arg);
+    double     every = run.ctx.opts.checkpointEvery;
+
+    if (every <= 0.0) every = 60.0;
+
+    pthread_mutex_lock(&run.lock);
+
+    while (run.outstanding > 0) {
+      struct timeval  now;
+      struct timespec deadline;
+
+      gettimeofday(&now, 0);
+      double when = now.tv_sec + now.tv_usec * 1e-6 + every;
+      deadline.tv_sec  = static_cast<time_t>(std::floor(when));
+      deadline.tv_nsec = static_cast<long>((when - deadline.tv_sec) * 1e9);
+
+      while (run.outstanding > 0  &&
+             pthread_cond_timedwait(&run.doneCond, &run.lock,
+                                    &deadline) != ETIMEDOUT) {}
+      if (run.outstanding == 0) break;
+
+      std::vector<dirTask>           frontier;
+      std::vector<checkpoint::dirId> done;
+
+      for (taskMap::const_iterator iter = run.running.begin();
+           iter != run.running.end();  iter++) {
+        frontier.push_back(iter->second);
+      }
+      for (poolMap::const_iterator iter = run.pools.begin();
+           iter != run.pools.end();  iter++) {
+        frontier.insert(frontier.end(), iter->second->pending.begin(),
+                        iter->second->pending.end());
+      }
+      frontier.insert(frontier.end(), run.stuck.begin(), run.stuck.end());
+      done.swap(run.done);
+      pthread_mutex_unlock(&run.lock);
+
+      string error;
+      bool   saved = run.ckpt->save(frontier, done, error);
+
+      if (! saved) {
+        run.ctx.report(run.ctx.opts.checkpoint, ltx::decision::skipped,
+                       error);
+      }
+
+      // The directories completed are logged again at the next save,
+      // if this one failed
+
+      pthread_mutex_lock(&run.lock);
+      if (! saved) run.done.insert(run.done.begin(), done.begin(), done.end());
+    }
+
+    pthread_mutex_unlock(&run.lock);
+    return 0;
+  }
+}
@@ -0,0 +1,71 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <list>
+#include <string>
+#include <vector>
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+#include "gitindex.hh"          // Includes: map, string, unordered_set
+
+class runContext;
+
+// The directory scheduler.
+//
+// The directories to be scanned are partitioned by the device they
+// live on: every device has its own queue, its own pool of
+// "options::jobs" scanner threads and its own throttle (see
+// throttle.hh), so that a slow or hung file system only delays the
+// scan of its own directories.  Pools are created the first time a
+// directory on a new device is found.
+//
+// If "options::prefetch" is positive, every pool has also a prefetch
+// thread, warming the caches (see fs_prefetch) for the next
+// "options::prefetch" directories in its queue; when a directory is
+// taken from the queue, it is accounted as a hit if its prefetch has
+// been completed, as late if it is still running, as a miss otherwise.
+//
+// The scan function is called once for every directory, and returns
+// the subdirectories to be scanned in turn; these are inserted at the
+// front of the queue of their device, in the order they were given,
+// so that a single thread visits a device depth first.
+//
+// If a checkpoint is given, a further thread saves the state of the
+// run from time to time (see checkpoint.hh); at the end the checkpoint
+// is removed, or keeps the directories that timed out, if any.
+//
+// All the state of a run is local to sched_run(): several runs may
+// proceed at the same time.
+
+class checkpoint;
+class pruneRules;
+
+struct dirTask {
+  std::string        name;
+  dev_t              dev;
+  ino_t              ino;
+  const pruneRules * rules;     // Pruning the subdirectories (see prune.hh)
+  gitScope           git;       // Files tracked by git (see gitindex.hh)
+  unsigned           depth;     // Below the target,
+  unsigned long      pathHash;  //   and the hash of the path from it.
+
+  dirTask(const std::string & n, dev_t d, ino_t i = 0,
+          const pruneRules * r = 0, const gitScope & g = gitScope())
+    : name(n), dev(d), ino(i), rules(r), git(g), depth(0),
+      pathHash(0) {}
+};
+
+typedef std::list<dirTask> taskList;
+typedef void (*scanFunction)(runContext &, const dirTask &, taskList &);
+
+void sched_run(runContext &, const taskList &, scanFunction,
+               std::vector<ltx::devStats> &, checkpoint * = 0);
+
+#endif // SCHED_H_
@@ -0,0 +1,487 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <deque>
+#include <list>
+#include <set>
+#include <sstream>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include "server.hh"            // Includes: string, liblintex.hh
+#include "dircache.hh"          // Includes: map, string, vector, ...
+#include "ltx.hh"               // Includes: functional, iostream, string
+#include "report.hh"            // Includes: iosfwd, list, map, set, ...
+
+extern "C" {
+  #include <pthread.h>
+  #include <unistd.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+}
+
+using std::string;
+using ltx::decision;
+
+// Local variables
+
+namespace {
+  const unsigned maxServed  = 16;       // Clients served at once, and
+  const size_t   maxWaiting = 64;       //   waiting for a worker at most
+
+  volatile sig_atomic_t stopping = 0;   // SIGINT or SIGTERM received
+}
+
+// Local types
+
+namespace {
+
+  // A client connection, and what its worker needs
+
+  struct client {
+    int                   fd;
+    const ltx::options  & opts;
+    ltx::dirCache       & cache;
+
+    client(int f, const ltx::options & o, ltx::dirCache & c)
+      : fd(f), opts(o), cache(c) {}
+  };
+
+  // The workers serving the clients: the connections accepted wait in
+  // a queue for the first one free.  When the pool is destroyed, the
+  // clients waiting are dropped, those being served see the end of
+  // their requests once the one running is answered, and the workers
+  // are joined.
+
+  class workerPool {
+  private:
+    const ltx::options     & _opts;
+    ltx::dirCache          & _cache;
+    pthread_mutex_t          _lock;
+    pthread_cond_t           _ready;
+    std::deque<int>          _waiting;
+    std::set<int>            _served;
+    std::vector<pthread_t>   _workers;
+    bool                     _closing;
+
+    static void * run(void *);
+
+  public:
+    workerPool(const ltx::options &, ltx::dirCache &);
+    ~workerPool();
+
+    bool start(unsigned);
+    bool add(int);
+  };
+
+  // The sink writing the decisions to a client, as JSON lines; they are
+  // buffered, and sent in chunks of about "chunk" bytes.
+
+  class replySink : public ltx::sink {
+  private:
+    static const string::size_type chunk = 65536;
+
+    int    _fd;
+    string _buffer;
+    bool   _broken;
+
+  public:
+    explicit replySink(int fd) : _fd(fd), _broken(false) {}
+
+    void decide(const decision &);
+    void line(const string &);
+    bool flush();
+  };
+}
+
+// Local functions (declarations)
+
+namespace {
+  void on_signal(int);
+  void serve_client(const client &);
+  void handle(const client &, const string &, replySink &);
+  void split(const string &, std::vector<string> &);
+}
+
+// Code
+
+int serve(
+  const string       & path,
+  const ltx::options & opts
+) {
+  // Listens on the socket "path" (removed first, if it exists), and
+  // hands the clients to a pool of workers; a client arriving when
+  // too many are waiting is told so and dropped.  Returns 0 when
+  // stopped by SIGINT or SIGTERM, 1 on errors.
+
+  using ltx::progname;
+
+  struct sockaddr_un address;
+
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << progname << ": \"" << path << "\" is too long\n";
+    return 1;
+  }
+
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path.c_str());
+
+  // A client going away must not kill the server; SIGINT and SIGTERM
+  // interrupt accept(), and only there: they are blocked in all the
+  // other threads.
+
+  struct sigaction action;
+  sigset_t         stops, old;
+
+  std::signal(SIGPIPE, SIG_IGN);
+
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = on_signal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT,  &action, 0);
+  sigaction(SIGTERM, &action, 0);
+
+  sigemptyset(&stops);
+  sigaddset(&stops, SIGINT);
+  sigaddset(&stops, SIGTERM);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  unlink(path.c_str());
+  if (listener < 0  ||
+      bind(listener, reinterpret_cast<struct sockaddr *>(&address),
+           sizeof(address)) != 0  ||
+      listen(listener, 16) != 0) {
+    std::cerr << progname << ": \"" << path << "\" cannot be served: "
+              << std::strerror(errno) << '\n';
+    return 1;
+  }
+
+  ltx::dirCache cache;
+  workerPool    pool(opts, cache);
+  int           status = 0;
+
+  pthread_sigmask(SIG_BLOCK, &stops, &old);
+  bool started = pool.start(maxServed);
+  pthread_sigmask(SIG_SETMASK, &old, 0);
+
+  if (! started) {
+    std::cerr << progname << ": \"" << path << "\": "
+              << std::strerror(errno) << '\n';
+    status = 1;
+  }
+
+  while (started  &&  ! stopping) {
+    int fd = accept(listener, 0, 0);
+
+    if (fd < 0) {
+      if (errno == EINTR  ||  errno == ECONNABORTED) continue;
+      std::cerr << progname << ": \"" << path << "\": "
+                << std::strerror(errno) << '\n';
+      status = 1;
+      break;
+    }
+
+    if (! pool.add(fd)) {
+      static const char busy[] = "{\"error\": \"too many clients\"}\n";
+
+      ssize_t ignored = write(fd, busy, sizeof(busy) - 1);
+      (void) ignored;
+      close(fd);
+    }
+  }
+
+  close(listener);
+  unlink(path.c_str());
+  return status;
+}
+
+// Methods for the class workerPool
+
+namespace {
+  workerPool::workerPool(
+    const ltx::options & opts,
+    ltx::dirCache      & cache
+  ) : _opts(opts), _cache(cache), _closing(false)
+  {
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_ready, 0);
+  }
+
+  workerPool::~workerPool()
+  {
+    pthread_mutex_lock(&_lock);
+    _closing = true;
+
+    for (std::deque<int>::iterator iter = _waiting.begin();
+         iter != _waiting.end();  iter++) {
+      close(*iter);
+    }
+    _waiting.clear();
+
+    for (std::set<int>::iterator iter = _served.begin();
+         iter != _served.end();  iter++) {
+      shutdown(*iter, SHUT_RD);
+    }
+
+    pthread_cond_broadcast(&_ready);
+    pthread_mutex_unlock(&_lock);
+
+    for (std::vector<pthread_t>::iterator iter = _workers.begin();
+         iter != _workers.end();  iter++) {
+      pthread_join(*iter, 0);
+    }
+
+    pthread_cond_destroy(&_ready);
+    pthread_mutex_destroy(&_lock);
+  }
+
+  bool workerPool::start(
+    unsigned n
+  ) {
+    // Starts "n" workers; false if not even one could be started
+
+    for (unsigned i = 0;  i < n;  i++) {
+      pthread_t id;
+      int       rc = pthread_create(&id, 0, run, this);
+
+      if (rc != 0) {
+        errno = rc;
+        break;
+      }
+      _workers.push_back(id);
+    }
+    return ! _workers.empty();
+  }
+
+  bool workerPool::add(
+    int fd
+  ) {
+    // Queues the client "fd"; false if too many are waiting already
+
+    pthread_mutex_lock(&_lock);
+
+    bool room = _waiting.size() < maxWaiting;
+
+    if (room) {
+      _waiting.push_back(fd);
+      pthread_cond_signal(&_ready);
+    }
+
+    pthread_mutex_unlock(&_lock);
+    return room;
+  }
+
+  void * workerPool::run(
+    void * arg
+  ) {
+    // Body of a worker: serves the clients, one at a time, until the
+    // pool is closed.
+
+    workerPool * pPool = static_cast<workerPool *>(arg);
+
+    pthread_mutex_lock(&pPool->_lock);
+
+    for (;;) {
+      while (pPool->_waiting.empty()  &&  ! pPool->_closing) {
+        pthread_cond_wait(&pPool->_ready, &pPool->_lock);
+      }
+      if (pPool->_closing) break;
+
+      int fd = pPool->_waiting.front();
+
+      pPool->_waiting.pop_front();
+      pPool->_served.insert(fd);
+      pthread_mutex_unlock(&pPool->_lock);
+
+      serve_client(client(fd, pPool->_opts, pPool->_cache));
+
+      pthread_mutex_lock(&pPool->_lock);
+      pPool->_served.erase(fd);
+      close(fd);
+    }
+
+    pthread_mutex_unlock(&pPool->_lock);
+    return 0;
+  }
+}
+
+// Methods for the class replySink
+
+namespace {
+  void replySink::decide(
+    const decision & d
+  ) {
+    static const char * const actions[] = {
+      "removed", "would-remove", "kept", "failed", "skipped"
+    };
+
+    std::ostringstream os;
+
+    os << "{\"path\": " << json_string(d.path)
+       << ", \"action\": \"" << actions[d.act] << '"';
+    if (! d.reason.empty()) os << ", \"reason\": " << json_string(d.reason);
+    os << '}';
+    line(os.str());
+  }
+
+  void replySink::line(
+    const string & text
+  ) {
+    _buffer += text;
+    _buffer += '\n';
+    if (_buffer.size() >= chunk) flush();
+  }
+
+  bool replySink::flush()
+  {
+    // Sends what has been buffered; returns false if the client is
+    // gone (then, everything else is discarded).
+
+    string::size_type sent = 0;
+
+    while (! _broken  &&  sent < _buffer.size()) {
+      ssize_t n = write(_fd, _buffer.data() + sent, _buffer.size() - sent);
+
+      if (n < 0) {
+        if (errno != EINTR) _broken = true;
+      } else {
+        sent += n;
+      }
+    }
+    _buffer.clear();
+    return ! _broken;
+  }
+}
+
+namespace {
+  void on_signal(
+    int
+  ) {
+    stopping = 1;
+  }
+
+  void serve_client(
+    const client & c
+  ) {
+    // Serves a client: reads the requests, one per line, and answers
+    // each one in turn, until the client (or the server) ends.
+
+    replySink out(c.fd);
+    string    pending;
+    char      buffer[4096];
+    ssize_t   n;
+
+    while ((n = read(c.fd, buffer, sizeof(buffer))) != 0) {
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+      pending.append(buffer, n);
+
+      string::size_type eol;
+      bool              gone = false;
+
+      while (! gone  &&  (eol = pending.find('\n')) != string::npos) {
+        string request = pending.substr(0, eol);
+
+        pending.erase(0, eol + 1);
+        if (! request.empty()  &&  *(request.rbegin()) == '\r') {
+          request.erase(request.size() - 1);
+        }
+        if (request.empty()) continue;
+
+        handle(c, request, out);
+        gone = ! out.flush();
+      }
+      if (gone) break;
+    }
+  }
+
+  void handle(
+    const client & c,
+    const string & request,
+    replySink    & out
+  ) {
+    // Decodes and runs a single request
+
+    std::vector<string> fields;
+    split(request, fields);
+
+    ltx::options o(c.opts);
+    o.cache   = &c.cache;
+    o.confirm = false;
+
+    std::vector<string>::const_iterator iter = fields.begin();
+
+    if (*iter == "pretend") {
+      o.pretend = true;
+    } else if (*iter != "clean") {
+      out.line("{\"error\": " + json_string("unknown request \"" + *iter +
+                                            '"') + '}');
+      return;
+    }
+
+    if (++iter != fields.end()  &&  *iter == "-r") {
+      o.recurse = true;
+      iter++;
+    }
+
+    std::list<string> targets;
+
+    for (;  iter != fields.end();  iter++) {
+      if (iter->empty()  ||  (*iter)[0] != '/') {
+        out.line("{\"error\": " +
+                 json_string("\"" + *iter + "\" is not an absolute path") +
+                 '}');
+        return;
+      }
+      targets.push_back(*iter);
+    }
+
+    if (targets.empty()) {
+      out.line("{\"error\": \"no directory given\"}");
+      return;
+    }
+
+    ltx::summary    result;
+    ltx::opCounters all;
+
+    ltx::clean(targets, o, out, result);
+
+    for (std::vector<ltx::devStats>::const_iterator jter =
+           result.devices.begin();
+         jter != result.devices.end();  jter++) {
+      all += jter->counters;
+    }
+
+    std::ostringstream os;
+    os << "{\"done\": true, \"dirs\": " << all.dirs
+       << ", \"entries\": " << all.entries << ", \"stats\": " << all.stats
+       << ", \"removed\": " << all.removed << ", \"errors\": " << all.errors
+       << ", \"timeouts\": " << all.timeouts << '}';
+    out.line(os.str());
+  }
+
+  void split(
+    const string        & text,
+    std::vector<string> & fields
+  ) {
+    // Splits "text" at every tab
+
+    string::size_type start = 0, tab;
+
+    while ((tab = text.find('\t', start)) != string::npos) {
+      fields.push_back(text.substr(start, tab - start));
+      start = tab + 1;
+    }
+    fields.push_back(text.substr(start));
+  }
+}
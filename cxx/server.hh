@@ -0,0 +1,43 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <string>
+#include "liblintex.hh"         // Includes: iosfwd, list, string, vector
+
+// "ltx --serve": cleans on request, from a UNIX domain socket.
+//
+// The clients are served by a fixed pool of threads, each serving one
+// connection at a time; the connections beyond those are queued, and
+// if too many are waiting a new one is answered {"error": "too many
+// clients"} and closed.  A client may send any number of requests, one
+// per line; the fields of a request are separated by tabs:
+//
+//     clean|pretend [-r] dir [dir ...]
+//
+// where the directories must be given as absolute paths.  The reply
+// is a sequence of JSON objects, one per line: one for every decision
+// taken, as {"path": ..., "action": ..., "reason": ...} (the action
+// being "removed", "would-remove", "kept", "failed" or "skipped"),
+// then {"done": true, ...} with the counters of the work done; or
+// {"error": ...} for a malformed request.
+//
+// All the requests share a cache of the directories scanned (see
+// dircache.hh): asking again to clean a directory that has not
+// changed costs little more than a stat of it.  The options given on
+// the command line apply to every request.
+//
+// SIGINT or SIGTERM stop the server: the requests running are answered,
+// the connections are closed, the socket is removed and serve()
+// returns 0; it returns 1 if the socket cannot be served.
+
+int serve(const std::string &, const ltx::options &);
+
+#endif // SERVER_H_
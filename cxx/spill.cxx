@@ -0,0 +1,314 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include "context.hh"           // Includes: string, vector, liblintex.hh
+#include "cleanup.hh"           // Includes: string, file.hh, gitindex.hh
+#include "fsops.hh"             // Includes: string, vector, dirent.h, ...
+#include "spill.hh"             // Includes: cstdio, string, vector, ...
+
+extern "C" {
+  #include <unistd.h>
+}
+
+using std::string;
+
+// Local types
+
+namespace {
+
+  // The records of a run: a backup file name, or a member of a family
+  // (the basename, and the number of its extension); the name follows.
+  // The backups are written first.
+
+  const unsigned backupExt = ~0U;
+
+  struct record {
+    time_t   sec;
+    long     nsec;
+    unsigned ext;
+    unsigned length;
+  };
+
+  // The head of a run being merged; "seq" orders the runs holding the
+  // same basename, so that the members of a family are seen in the
+  // order they were found.
+
+  struct runHead {
+    FILE     * fp;
+    unsigned   seq;
+    string     name;
+    unsigned   ext;
+    fileTime   mTime;
+    bool       bad;
+
+    runHead(FILE * f, unsigned s) : fp(f), seq(s), ext(0), bad(false) {}
+    bool next();
+  };
+
+  struct laterHead {
+    bool operator() (const runHead * lhs, const runHead * rhs) const {
+      int c = lhs->name.compare(rhs->name);
+      return c > 0  ||  (c == 0  &&  lhs->seq > rhs->seq);
+    }
+  };
+
+  typedef std::priority_queue< runHead *, std::vector<runHead *>,
+                               laterHead > headQueue;
+}
+
+// Code
+
+dirSpill::dirSpill(
+  const runContext & ctx,
+  unsigned           share
+) : _ctx(ctx), _cap(ctx.opts.maxMemory / share), _failed(false)
+{
+}
+
+dirSpill::~dirSpill()
+{
+  release();
+}
+
+void dirSpill::check(
+  currDir & dir
+) {
+  // Spills "dir" if the memory its families take is beyond the cap
+
+  if (_cap > 0.0  &&  ! _failed  &&  dir.bytes() > _cap) spill(dir);
+}
+
+bool dirSpill::clean(
+  runContext     & ctx,
+  currDir        & dir,
+  const gitScope & git
+) {
+  // Cleans the directory spilled to the runs, and what is left of it in
+  // "dir" (used for the batches); false if the runs could not be
+  // written (nothing has been removed then) or read back.
+
+  if (! _failed  &&  (dir.begin() != dir.end()  ||  ! dir.backups().empty())) {
+    spill(dir);
+  }
+  if (_failed) return false;
+
+  // Too many runs: the oldest ones are merged first
+
+  while (_runs.size() > maxRuns) {
+    std::vector<FILE *> oldest(_runs.begin(), _runs.begin() + maxRuns);
+    FILE              * run = create();
+
+    if (run == 0  ||  ! merge(oldest, run, 0, 0, 0)  ||
+        std::fflush(run) != 0) {
+      if (run) std::fclose(run);
+      return false;
+    }
+
+    for (std::vector<FILE *>::iterator iter = oldest.begin();
+         iter != oldest.end();  iter++) {
+      std::fclose(*iter);
+    }
+    _runs.erase(_runs.begin() + 1, _runs.begin() + maxRuns);
+    _runs[0] = run;
+  }
+
+  bool ok = merge(_runs, 0, &dir, &git, &ctx);
+  release();
+  return ok;
+}
+
+void dirSpill::spill(
+  currDir & dir
+) {
+  // Writes the families held in "dir" to a new run, and empties it.
+  // On failure "dir" is left alone, and nothing more is written.
+
+  const std::vector<string> & exts = _ctx.exts.extensions();
+  FILE                      * run  = create();
+  bool                        ok   = run != 0;
+
+  for (std::list<string>::const_iterator iter = dir.backups().begin();
+       ok  &&  iter != dir.backups().end();  iter++) {
+    ok = write(run, *iter, backupExt, fileTime());
+  }
+
+  for (fileCollection::const_iterator iter = dir.begin();
+       ok  &&  iter != dir.end();  iter++) {
+    const fileFamily & fF = *iter->second;
+
+    if (fF.hasTex()) ok = write(run, iter->first, 0, fF.texMtime());
+
+    for (std::list<extInfo>::const_iterator jter = fF.begin();
+         ok  &&  jter != fF.end();  jter++) {
+      unsigned id = std::lower_bound(exts.begin(), exts.end(), jter->first) -
+                    exts.begin();
+      ok = write(run, iter->first, id + 1, jter->second);
+    }
+  }
+
+  if (ok  &&  std::fflush(run) == 0) {
+    _runs.push_back(run);
+    dir.clear();
+  } else {
+    if (run) std::fclose(run);
+    _failed = true;
+  }
+}
+
+FILE * dirSpill::create()
+{
+  // Makes a temporary file, unlinked at once, open for reading and
+  // writing.
+
+  const char * tmp  = std::getenv("TMPDIR");
+  string       path = string(tmp && *tmp ? tmp : "/tmp") + "/ltx-spill.XXXXXX";
+
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+
+  int fd = mkstemp(&name[0]);
+  if (fd < 0) return 0;
+  unlink(&name[0]);
+
+  FILE * fp = fdopen(fd, "w+b");
+  if (fp == 0) close(fd);
+  return fp;
+}
+
+bool dirSpill::write(
+  FILE           * run,
+  const string   & name,
+  unsigned         ext,
+  const fileTime & mTime
+) {
+  record r;
+
+  r.sec    = mTime.sec;
+  r.nsec   = mTime.nsec;
+  r.ext    = ext;
+  r.length = name.size();
+
+  return std::fwrite(&r, sizeof(r), 1, run) == 1  &&
+         std::fwrite(name.data(), 1, name.size(), run) == name.size();
+}
+
+bool dirSpill::merge(
+  std::vector<FILE *> & runs,
+  FILE                * out,
+  currDir             * batch,
+  const gitScope      * git,
+  runContext          * ctx
+) {
+  // Merges "runs" by basename: to the run "out", or else to "batch",
+  // cleaned (with "git") whenever it holds more than the cap, and at
+  // the end.  The backups of all the runs come first.
+
+  const std::vector<string> & exts = _ctx.exts.extensions();
+  std::vector<runHead>        heads;
+  headQueue                   pending;
+  bool                        ok = true;
+
+  heads.reserve(runs.size());
+  for (std::vector<FILE *>::size_type i = 0;  i < runs.size();  i++) {
+    std::rewind(runs[i]);
+    heads.push_back(runHead(runs[i], i));
+  }
+
+  for (std::vector<runHead>::iterator iter = heads.begin();
+       ok  &&  iter != heads.end();  iter++) {
+    bool more;
+
+    while ((more = iter->next())  &&  iter->ext == backupExt) {
+      if (out) {
+        ok = write(out, iter->name, backupExt, fileTime());
+        if (! ok) break;
+      } else {
+        batch->addBackup(iter->name);
+        if (batch->bytes() > _cap) {
+          clean_files(*ctx, *batch, *git);
+          batch->clear();
+        }
+      }
+    }
+
+    if (more) pending.push(&*iter);
+    if (iter->bad) ok = false;
+  }
+
+  string last;
+
+  while (ok  &&  ! pending.empty()  &&  ! fs_stuck()) {
+    runHead * head = pending.top();
+    pending.pop();
+
+    if (out) {
+      ok = write(out, head->name, head->ext, head->mTime);
+
+    } else if (head->ext == backupExt  ||  head->ext > exts.size()) {
+      ok = false;
+
+    } else {
+      if (head->name != last  &&  batch->bytes() > _cap) {
+        clean_files(*ctx, *batch, *git);
+        batch->clear();
+      }
+      batch->getFileFamily(head->name).addExtension(
+        head->mTime, head->ext == 0 ? 0 : &exts[head->ext - 1]);
+      last = head->name;
+    }
+
+    if (head->next()) pending.push(head);
+    if (head->bad) ok = false;
+  }
+
+  if (ok  &&  batch  &&  ! fs_stuck()) {
+    clean_files(*ctx, *batch, *git);
+    batch->clear();
+  }
+
+  return ok;
+}
+
+void dirSpill::release()
+{
+  for (std::vector<FILE *>::iterator iter = _runs.begin();
+       iter != _runs.end();  iter++) {
+    std::fclose(*iter);
+  }
+  _runs.clear();
+}
+
+// Local functions (definitions)
+
+namespace {
+  bool runHead::next()
+  {
+    // Reads the next record; false at the end of the run, or if it
+    // could not be read (then "bad" is set).
+
+    record r;
+
+    if (std::fread(&r, sizeof(r), 1, fp) != 1) {
+      bad = std::ferror(fp) != 0  ||  ! std::feof(fp);
+      return false;
+    }
+
+    name.resize(r.length);
+    if (r.length > 0  &&  std::fread(&name[0], 1, r.length, fp) != r.length) {
+      bad = true;
+      return false;
+    }
+
+    ext   = r.ext;
+    mTime = fileTime(r.sec, r.nsec);
+    return true;
+  }
+}
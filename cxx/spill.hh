@@ -0,0 +1,75 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef SPILL_H_
+#define SPILL_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "file.hh"              // Includes: list, map, string, utility, ...
+#include "gitindex.hh"          // Includes: map, string, unordered_set
+
+class runContext;
+
+// Directories too large to be held in memory ("options::maxMemory").
+//
+// While a directory is read, its file families are collected in a
+// currDir as usual; when the memory held there goes beyond the cap,
+// the families are written to a temporary "run" file and the currDir
+// is emptied.  Every run holds compact records of the files, in
+// basename order (that of the currDir map): the basename, the number
+// of the extension in the extension table (0 for ".tex") and the
+// modification time.  The editor backups come first in every run.
+//
+// Once the directory has been read, the runs are merged by basename,
+// so that every family is seen whole again, and cleaned in batches
+// fitting in the cap: the decisions are the same, and are taken in the
+// same order, as if the directory had been held in memory.  No more
+// than "maxRuns" runs are merged at once: the oldest ones are merged
+// to a single run beforehand.
+//
+// The cap holds for every directory being read: with several scanner
+// threads, for each of them; a directory split in "share" parts (see
+// fanout.hh) gives a share of the cap to each one.  The temporary
+// files are made in $TMPDIR (or /tmp), and unlinked as soon as
+// created.  If a run cannot be written, nothing more is spilled and
+// clean() fails (before removing anything), unless no run had been
+// written: the directory is then just held in memory.  If a run
+// cannot be read back, clean() stops.
+
+class dirSpill {
+private:
+  static const std::vector<FILE *>::size_type maxRuns = 64;
+
+  const runContext   & _ctx;
+  double               _cap;
+  std::vector<FILE *>  _runs;
+  bool                 _failed;
+
+  void   spill(currDir &);
+  FILE * create();
+  bool   write(FILE *, const std::string &, unsigned, const fileTime &);
+  bool   merge(std::vector<FILE *> &, FILE *, currDir *, const gitScope *,
+               runContext *);
+  void   release();
+
+  dirSpill & operator = (const dirSpill & rhs);
+  dirSpill(const dirSpill & rhs);
+
+public:
+  dirSpill(const runContext &, unsigned = 1);
+  ~dirSpill();
+
+  bool used() const { return ! _runs.empty(); }
+
+  void check(currDir &);
+  bool clean(runContext &, currDir &, const gitScope &);
+};
+
+#endif // SPILL_H_
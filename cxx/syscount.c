@@ -0,0 +1,323 @@
+/*
+ * $Id$
+ *
+ * Counts the system calls made for the file system operations that
+ * matter to lintex and ltx; loaded with LD_PRELOAD by check-syscalls.sh
+ * (see "make check").
+ *
+ * At exit, one line "name count" for every counter is appended to the
+ * file named by the environment variable SYSCOUNT_OUT (to the standard
+ * error, if it is not set).  The calls are intercepted at the library
+ * interface, so the system calls issued inside the library must be
+ * inferred: opendir(3) issues one openat, and readdir(3) one getdents64
+ * every time its buffer is refilled.  A refill is seen when the entry
+ * returned is not past the one returned before from the same stream
+ * (the buffer is filled again from its start), and when readdir(3)
+ * returns NULL (the last getdents64, which found nothing).  The direct
+ * calls of getdents64, and those made through syscall(2), are counted
+ * too.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+enum {
+  cStat, cStatx, cOpenat, cGetdents, cUnlink, cAccess, cCounters
+};
+
+static const char * const names[cCounters] = {
+  "stat", "statx", "openat", "getdents64", "unlink", "access"
+};
+
+static unsigned long counts[cCounters];
+
+#define COUNT(c)         __sync_fetch_and_add(&counts[c], 1)
+#define NEXT(type, name) ((type) dlsym(RTLD_NEXT, name))
+
+/* The directory streams open, with the last entry each one returned:
+   an open addressing hash table, whose slots freed by closedir(3) are
+   marked as such, under a spin lock. */
+
+#define NSTREAMS 4096
+
+static struct stream {
+  DIR        *dir;
+  const void *last;
+} streams[NSTREAMS];
+
+static DIR * const freed = (DIR *) 1;
+static int         locked;
+
+static struct stream *find(DIR *dir, int add)
+{
+  /* The slot of "dir" (taken, if "add" and not found); NULL if the
+     table is full */
+
+  size_t          h     = ((size_t) dir >> 4) % NSTREAMS;
+  struct stream  *empty = 0;
+  size_t          i;
+
+  for (i = 0;  i < NSTREAMS;  i++, h = (h + 1) % NSTREAMS) {
+    if (streams[h].dir == dir) return &streams[h];
+    if (streams[h].dir == freed  &&  empty == 0) empty = &streams[h];
+    if (streams[h].dir == 0) {
+      if (empty == 0) empty = &streams[h];
+      break;
+    }
+  }
+
+  if (! add  ||  empty == 0) return 0;
+  empty->dir  = dir;
+  empty->last = 0;
+  return empty;
+}
+
+static void opened(DIR *dir)
+{
+  /* A new stream, whose first entry will come from a getdents64 */
+
+  if (dir == 0) return;
+  while (__sync_lock_test_and_set(&locked, 1)) ;
+  find(dir, 1);
+  __sync_lock_release(&locked);
+}
+
+static void returned(DIR *dir, const void *entry)
+{
+  /* Counts the getdents64 issued by readdir(3), if it returned "entry"
+     after refilling its buffer */
+
+  struct stream *s;
+  int            refilled = 1;
+
+  while (__sync_lock_test_and_set(&locked, 1)) ;
+  if ((s = find(dir, 1)) != 0) {
+    refilled  = entry == 0  ||  s->last == 0  ||
+                (const char *) entry <= (const char *) s->last;
+    s->last = entry;
+  }
+  __sync_lock_release(&locked);
+
+  if (refilled) COUNT(cGetdents);
+}
+
+static void dump(void) __attribute__((destructor));
+
+static void dump(void)
+{
+  const char *out = getenv("SYSCOUNT_OUT");
+  FILE       *fp  = out != 0 ? fopen(out, "a") : stderr;
+  int         i;
+
+  if (fp == 0) return;
+  for (i = 0;  i < cCounters;  i++) {
+    fprintf(fp, "%s %lu\n", names[i], counts[i]);
+  }
+  if (fp != stderr) fclose(fp);
+}
+
+/* The stat family, in all the names it has had in glibc */
+
+#define STAT(name, stype)                                             \
+  int name(const char *path, struct stype *buf)                       \
+  {                                                                   \
+    COUNT(cStat);                                                     \
+    return NEXT(int (*)(const char *, struct stype *), #name)(path, buf); \
+  }
+
+#define XSTAT(name, stype)                                            \
+  int name(int ver, const char *path, struct stype *buf)              \
+  {                                                                   \
+    COUNT(cStat);                                                     \
+    return NEXT(int (*)(int, const char *, struct stype *), #name)(   \
+      ver, path, buf);                                                \
+  }
+
+STAT(stat, stat)
+STAT(lstat, stat)
+STAT(stat64, stat64)
+STAT(lstat64, stat64)
+XSTAT(__xstat, stat)
+XSTAT(__lxstat, stat)
+XSTAT(__xstat64, stat64)
+XSTAT(__lxstat64, stat64)
+
+int fstatat(int dirfd, const char *path, struct stat *buf, int flags)
+{
+  COUNT(cStat);
+  return NEXT(int (*)(int, const char *, struct stat *, int), "fstatat")(
+    dirfd, path, buf, flags);
+}
+
+int fstatat64(int dirfd, const char *path, struct stat64 *buf, int flags)
+{
+  COUNT(cStat);
+  return NEXT(int (*)(int, const char *, struct stat64 *, int),
+              "fstatat64")(dirfd, path, buf, flags);
+}
+
+int statx(int dirfd, const char *path, int flags, unsigned int mask,
+          struct statx *buf)
+{
+  COUNT(cStatx);
+  return NEXT(int (*)(int, const char *, int, unsigned int,
+                      struct statx *), "statx")(dirfd, path, flags, mask,
+                                                buf);
+}
+
+/* Opening files and directories */
+
+#define OPEN(name)                                                    \
+  int name(const char *path, int flags, ...)                          \
+  {                                                                   \
+    mode_t  mode = 0;                                                 \
+    va_list ap;                                                       \
+                                                                      \
+    va_start(ap, flags);                                              \
+    if (flags & (O_CREAT | O_TMPFILE)) mode = va_arg(ap, mode_t);     \
+    va_end(ap);                                                       \
+    COUNT(cOpenat);                                                   \
+    return NEXT(int (*)(const char *, int, ...), #name)(path, flags, mode); \
+  }
+
+#define OPENAT(name)                                                  \
+  int name(int dirfd, const char *path, int flags, ...)               \
+  {                                                                   \
+    mode_t  mode = 0;                                                 \
+    va_list ap;                                                       \
+                                                                      \
+    va_start(ap, flags);                                              \
+    if (flags & (O_CREAT | O_TMPFILE)) mode = va_arg(ap, mode_t);     \
+    va_end(ap);                                                       \
+    COUNT(cOpenat);                                                   \
+    return NEXT(int (*)(int, const char *, int, ...), #name)(         \
+      dirfd, path, flags, mode);                                      \
+  }
+
+OPEN(open)
+OPEN(open64)
+OPENAT(openat)
+OPENAT(openat64)
+
+DIR *opendir(const char *path)
+{
+  DIR *dir = NEXT(DIR *(*)(const char *), "opendir")(path);
+
+  COUNT(cOpenat);
+  opened(dir);
+  return dir;
+}
+
+DIR *fdopendir(int fd)
+{
+  /* The directory is open already: no openat */
+
+  DIR *dir = NEXT(DIR *(*)(int), "fdopendir")(fd);
+
+  opened(dir);
+  return dir;
+}
+
+int closedir(DIR *dir)
+{
+  struct stream *s;
+
+  while (__sync_lock_test_and_set(&locked, 1)) ;
+  if ((s = find(dir, 0)) != 0) s->dir = freed;
+  __sync_lock_release(&locked);
+
+  return NEXT(int (*)(DIR *), "closedir")(dir);
+}
+
+struct dirent *readdir(DIR *dir)
+{
+  struct dirent *entry = NEXT(struct dirent *(*)(DIR *), "readdir")(dir);
+
+  returned(dir, entry);
+  return entry;
+}
+
+struct dirent64 *readdir64(DIR *dir)
+{
+  struct dirent64 *entry =
+    NEXT(struct dirent64 *(*)(DIR *), "readdir64")(dir);
+
+  returned(dir, entry);
+  return entry;
+}
+
+ssize_t getdents64(int fd, void *buf, size_t size)
+{
+  COUNT(cGetdents);
+  return NEXT(ssize_t (*)(int, void *, size_t), "getdents64")(fd, buf,
+                                                              size);
+}
+
+long syscall(long number, ...)
+{
+  /* The arguments are passed on as they are, six of them */
+
+  long    a[6];
+  va_list ap;
+  int     i;
+
+  va_start(ap, number);
+  for (i = 0;  i < 6;  i++) a[i] = va_arg(ap, long);
+  va_end(ap);
+
+  switch (number) {
+    case SYS_getdents64: COUNT(cGetdents); break;
+    case SYS_openat:     COUNT(cOpenat);   break;
+#ifdef SYS_statx
+    case SYS_statx:      COUNT(cStatx);    break;
+#endif
+    case SYS_unlinkat:   COUNT(cUnlink);   break;
+  }
+
+  return NEXT(long (*)(long, ...), "syscall")(number, a[0], a[1], a[2],
+                                              a[3], a[4], a[5]);
+}
+
+/* Removing files, and asking for permissions */
+
+int unlink(const char *path)
+{
+  COUNT(cUnlink);
+  return NEXT(int (*)(const char *), "unlink")(path);
+}
+
+int unlinkat(int dirfd, const char *path, int flags)
+{
+  COUNT(cUnlink);
+  return NEXT(int (*)(int, const char *, int), "unlinkat")(dirfd, path,
+                                                           flags);
+}
+
+int remove(const char *path)
+{
+  COUNT(cUnlink);
+  return NEXT(int (*)(const char *), "remove")(path);
+}
+
+int access(const char *path, int mode)
+{
+  COUNT(cAccess);
+  return NEXT(int (*)(const char *, int), "access")(path, mode);
+}
+
+int faccessat(int dirfd, const char *path, int mode, int flags)
+{
+  COUNT(cAccess);
+  return NEXT(int (*)(int, const char *, int, int), "faccessat")(
+    dirfd, path, mode, flags);
+}
@@ -0,0 +1,130 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#include <algorithm>
+#include "throttle.hh"          // Includes: pthread.h
+
+extern "C" {
+  #include <time.h>
+}
+
+namespace {
+  const double minThreshold(0.001);  // Floor of the automatic target
+  const double autoFactor(4.0);      // Automatic target / min latency
+
+  void sleep_for(
+    double seconds
+  ) {
+    struct timespec ts;
+    ts.tv_sec  = static_cast<time_t>(seconds);
+    ts.tv_nsec = static_cast<long>((seconds - ts.tv_sec) * 1e9);
+    nanosleep(&ts, 0);
+  }
+}
+
+double mono_time()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Methods for the class opThrottle
+
+opThrottle::opThrottle(
+  double   rate,
+  unsigned maxInFlight,
+  bool     adaptive,
+  double   target
+) : _rate(rate), _burst(std::max(1.0, rate / 10.0)), _tokens(_burst),
+    _refill(mono_time()), _adaptive(adaptive), _target(target),
+    _limit(adaptive ? 1.0 : maxInFlight), _maxLimit(maxInFlight),
+    _inFlight(0), _minLatency(1e9), _lastCut(0.0),
+    _nOps(0), _totLatency(0.0)
+{
+  if (_maxLimit < 1.0) _maxLimit = _limit = 1.0;
+  pthread_mutex_init(&_lock, 0);
+  pthread_cond_init(&_slot, 0);
+}
+
+opThrottle::~opThrottle()
+{
+  pthread_cond_destroy(&_slot);
+  pthread_mutex_destroy(&_lock);
+}
+
+double opThrottle::begin()
+{
+  // Waits first for a token (if the rate is limited), then for a free
+  // slot (if the in-flight limit has been reached); returns the time
+  // at which the operation may start.
+
+  pthread_mutex_lock(&_lock);
+
+  if (_rate > 0.0) {
+    for (;;) {
+      double now = mono_time();
+      _tokens = std::min(_burst, _tokens + (now - _refill) * _rate);
+      _refill = now;
+      if (_tokens >= 1.0) break;
+
+      double wait = (1.0 - _tokens) / _rate;
+      pthread_mutex_unlock(&_lock);
+      sleep_for(wait);
+      pthread_mutex_lock(&_lock);
+    }
+    _tokens -= 1.0;
+  }
+
+  while (_inFlight >= static_cast<unsigned>(_limit)) {
+    pthread_cond_wait(&_slot, &_lock);
+  }
+  _inFlight++;
+
+  pthread_mutex_unlock(&_lock);
+  return mono_time();
+}
+
+void opThrottle::end(
+  double start
+) {
+  // Releases the slot taken by an operation started at "start", and
+  // feeds its latency to the AIMD controller.
+
+  double now     = mono_time();
+  double latency = now - start;
+
+  pthread_mutex_lock(&_lock);
+
+  _inFlight--;
+  _nOps++;
+  _totLatency += latency;
+
+  if (_adaptive) {
+    if (latency < _minLatency) _minLatency = latency;
+
+    double threshold = _target > 0.0 ? _target
+      : std::max(minThreshold, autoFactor * _minLatency);
+
+    if (latency > threshold) {
+
+      // Only operations started after the last decrease are a fresh
+      // congestion signal: the others were issued under the old limit.
+
+      if (start > _lastCut) {
+        _limit   = std::max(1.0, _limit / 2.0);
+        _lastCut = now;
+      }
+    } else {
+      _limit = std::min(_maxLimit, _limit + 1.0 / _limit);
+    }
+  }
+
+  pthread_cond_broadcast(&_slot);
+  pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,94 @@
+// -------------------------------------------------------------------
+//
+//     Part of ltx, the C++ version of "lintex" (see ltx.cxx).  It is
+//     distributed under the terms of the GNU General Public License,
+//     version 2 (see the file COPYING).
+//
+// -------------------------------------------------------------------
+
+#ifndef THROTTLE_H_
+#define THROTTLE_H_
+
+extern "C" {
+  #include <pthread.h>
+}
+
+// Flow control for the metadata operations (stat, unlink, readdir)
+// issued against the file system by the scanner threads.
+//
+// - A token bucket limits the rate of the operations to a given
+//   number per second (a rate of 0 means "no limit"); the bucket
+//   holds at most a tenth of a second worth of tokens, so that no
+//   large burst is sent after an idle period.
+//
+// - An AIMD (additive increase, multiplicative decrease) controller
+//   limits the number of operations in flight at the same time: the
+//   limit grows by about one for every window of operations completed
+//   under the target latency, and is halved (at most once per window)
+//   when an operation takes longer than that.  If no explicit target
+//   is given, it is four times the lowest latency seen so far, but
+//   never less than one millisecond.
+//
+// Every operation must be bracketed by begin() and end(); the
+// auxiliary class "opGuard" does exactly that in its constructor and
+// destructor (doing nothing if no throttle is given).
+
+class opThrottle {
+private:
+  pthread_mutex_t _lock;
+  pthread_cond_t  _slot;
+
+  double   _rate;               // Token bucket: operations per second,
+  double   _burst;              //   bucket capacity,
+  double   _tokens;             //   current content,
+  double   _refill;             //   time of the last refill.
+
+  bool     _adaptive;           // AIMD controller: enabled or not,
+  double   _target;             //   target latency (0 = automatic),
+  double   _limit;              //   current in-flight limit,
+  double   _maxLimit;           //   its upper bound,
+  unsigned _inFlight;           //   operations currently in flight,
+  double   _minLatency;         //   lowest latency seen so far,
+  double   _lastCut;            //   time of the last decrease.
+
+  unsigned long _nOps;          // Statistics: number of operations,
+  double        _totLatency;    //   and their total latency.
+
+  // Prevents any use of the copy constructor and of the assignment
+  // operator
+
+  opThrottle & operator = (const opThrottle & rhs);
+  opThrottle(const opThrottle & rhs);
+
+public:
+  opThrottle(double rate, unsigned maxInFlight,
+             bool adaptive, double target);
+  ~opThrottle();
+
+  double begin();
+  void   end(double);
+
+  double        limit()       const { return _limit; }
+  unsigned long operations()  const { return _nOps; }
+  double        meanLatency() const {
+    return _nOps ? _totLatency / _nOps : 0.0; }
+};
+
+class opGuard {
+private:
+  opThrottle * _pThrottle;
+  double       _start;
+
+  opGuard & operator = (const opGuard & rhs);
+  opGuard(const opGuard & rhs);
+
+public:
+  opGuard(opThrottle * p) : _pThrottle(p), _start(p ? p->begin() : 0.0) {}
+  ~opGuard() { if (_pThrottle) _pThrottle->end(_start); }
+};
+
+// Monotonic clock, in seconds
+
+double mono_time();
+
+#endif // THROTTLE_H_
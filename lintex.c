@@ -66,17 +66,84 @@
  | Included files
 **/
 
+#define _GNU_SOURCE             /* For d_type in struct dirent, statx */
+
 #include <stdio.h>              /* Standard library */
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include <sys/types.h>          /* Unix proper */
 #include <sys/stat.h>
 #include <dirent.h>
 
+/**
+ | Static tracepoints (USDT, provider "lintex"), the same as those of
+ | ltx (see cxx/probes.hh for their arguments):
+ |
+ |     dir_open, dir_close, entry_classified, family_decided,
+ |     unlink_start, unlink_done
+ |
+ | They are built with <sys/sdt.h> (from SystemTap) if it is found, and
+ | unless NO_PROBES is defined; otherwise they compile to nothing.  The
+ | arguments are computed, and the clock is read, only when a tracer
+ | has raised the semaphore of the probe.
+**/
+
+#if ! defined(NO_PROBES)  &&  defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    define LINTEX_PROBES 1
+#  endif
+#endif
+
+#ifdef LINTEX_PROBES
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define SEMAPHORE(name)                                   \
+  volatile unsigned short lintex_##name##_semaphore       \
+    __attribute__((section(".probes"))) = 0
+
+SEMAPHORE(dir_open);
+SEMAPHORE(dir_close);
+SEMAPHORE(entry_classified);
+SEMAPHORE(family_decided);
+SEMAPHORE(unlink_start);
+SEMAPHORE(unlink_done);
+
+#define PROBE_ENABLED(name)                               \
+  __builtin_expect(lintex_##name##_semaphore != 0, 0)
+#define PROBE1(name, a)                                   \
+  do {                                                    \
+    if (PROBE_ENABLED(name)) DTRACE_PROBE1(lintex, name, a); \
+  } while (0)
+#define PROBE3(name, a, b, c)                             \
+  do {                                                    \
+    if (PROBE_ENABLED(name)) DTRACE_PROBE3(lintex, name, a, b, c); \
+  } while (0)
+#define PROBE4(name, a, b, c, d)                          \
+  do {                                                    \
+    if (PROBE_ENABLED(name)) DTRACE_PROBE4(lintex, name, a, b, c, d); \
+  } while (0)
+
+#else
+
+#define PROBE_ENABLED(name)       0
+#define PROBE1(name, a)           do { if (0) { (void) (a); } } while (0)
+#define PROBE3(name, a, b, c)                             \
+  do { if (0) { (void) (a); (void) (b); (void) (c); } } while (0)
+#define PROBE4(name, a, b, c, d)                          \
+  do {                                                    \
+    if (0) { (void) (a); (void) (b); (void) (c); (void) (d); } \
+  } while (0)
+
+#endif
+
 /**
  | Definitions:
  | - LONG_ENOUGH: length of the buffer used to read the answer from the
@@ -113,7 +180,8 @@
  |     these linked lists are also used to store directory names (with fake
  |     extension strings).
  | - Fnode: an entry in the linked list of the file names; contains the
- |     file modification time, the file name and a pointer to the next node.
+ |     file modification time (seconds and nanoseconds), the file name and
+ |     a pointer to the next node.
  |     As a side note, the so called 'struct hack', here used to store the
  |     file name, is not guaranteed to work by the current C ANSI standard;
  |     but no environment/compiler where it does not work is currently
@@ -128,8 +196,8 @@ typedef struct sFroot {
 
 typedef struct sFnode {
   time_t mTime;
+  long   mNsec;
   struct sFnode *next;
-  int write;
   char name[1];
 } Fnode;
 
@@ -141,6 +209,7 @@ typedef struct sFnode {
  | - output_level: See the definitions above for more details;
  | - pretend: will be 0 or 1 according to -p command option;
  | - older: will be 0 or 1 according to -o command option;
+ | - noSync: will be 0 or 1 according to -n command option;
  | - bExt: the extension for backup files: defaults to "~" (the emacs
  |   convention);
  | - n_bExt: the length of the previous string;
@@ -157,6 +226,7 @@ static int     keep            = FALSE;
 static int     output_level    = WHISPER;
 static int     pretend         = FALSE;
 static int     older           = FALSE;
+static int     noSync          = FALSE;
 static char    bExt[MAX_B_EXT] = "~";
 static size_t  n_bExt;
 static char   *programName;
@@ -201,11 +271,14 @@ static char  *baseName(char *);
 static Froot *buildTree(char *, Froot *);
 static void   clean(char *);
 static void   examineTree(Froot *, char *);
-static void   insertNode(char *, size_t, time_t, int, Froot *);
+static int    getAttributes(char *, int *, time_t *, long *);
+static void   insertNode(char *, size_t, time_t, long, Froot *);
+static int    isNewer(Fnode *, Fnode *);
 static void   noMemory(void);
 static void   nuke(char *);
 static void   putsMessage(char *, int);
 static void   printTree(Froot *);
+static unsigned long probeNs(void);
 static void   releaseTree(Froot *);
 static void   syntax(void);
 
@@ -272,6 +345,10 @@ int main(
           older = TRUE;
           break;
 
+        case 'n':   case 'N':
+          noSync = TRUE;
+          break;
+
         default:
           syntax();
       }
@@ -316,7 +393,7 @@ static void insertNode(
   char   *name,
   size_t  lName,
   time_t  mTime,
-  int write,
+  long    mNsec,
   Froot  *root
 ){
 
@@ -339,7 +416,7 @@ static void insertNode(
     noMemory();
   }
   pFN->mTime = mTime;
-  pFN->write = write;
+  pFN->mNsec = mNsec;
   pFN->next  = 0;
 
   if (lName == 0) {
@@ -357,6 +434,23 @@ static void insertNode(
   root->lastNode = pFN;
 }
 
+static int isNewer(
+  Fnode *pA,
+  Fnode *pB
+){
+
+  /**
+   | Tells whether the file of "pA" has been modified after the one of
+   | "pB", to the nanosecond: TeX and its outputs often write within the
+   | same second.
+  **/
+
+  if (pA->mTime != pB->mTime) {
+    return difftime(pA->mTime, pB->mTime) > 0.0;
+  }
+  return pA->mNsec > pB->mNsec;
+}
+
 static void noMemory(void)
 {
   fprintf(stderr, "%s: couldn't obtain heap memory\n", programName);
@@ -416,6 +510,8 @@ static Froot *buildTree(
   DIR           *pDir;         /* Pointer returned from opendir()    */
   struct dirent *pDe;          /* Pointer returned from readdir()    */
   Froot         *teXTree;      /* Root node of the TeX-related files */
+  unsigned long  nRead = 0;    /* Entries read, for the probes       */
+  unsigned long  started = 0;  /* When the directory was opened      */
 
   if (output_level >= DEBUG) {
     printf("* Scanning directory \"%s\" - confirm = %c, recurse = %c, ",
@@ -432,6 +528,9 @@ static Froot *buildTree(
     return 0;
   }
 
+  PROBE1(dir_open, dirName);
+  if (PROBE_ENABLED(dir_close)) started = probeNs();
+
   if ((teXTree = malloc(sizeof(protoTree))) == 0) {
     noMemory();
   }
@@ -439,10 +538,14 @@ static Froot *buildTree(
 
   while ((pDe = readdir(pDir)) != 0) {
     char    tName[FILENAME_MAX];         /* Fully qualified file name       */
-    struct  stat sStat;                  /* To be filled by stat(2)         */
+    int     isDir;                       /* The file attributes we need     */
+    time_t  mTime;
+    long    mNsec;
     size_t  len;                         /* Lenght of the current file name */
     size_t  last;                        /* Index of its last character     */
     char   *pFe;                         /* Pointer to file extension       */
+    size_t  nameLen;                     /* Its offset in the file name     */
+    Froot  *pTT;                         /* The list of that extension      */
 
     /**
      | - Tests for empty inodes (already removed files);
@@ -451,6 +554,7 @@ static Froot *buildTree(
      |   the backup files, to be always deleted.
     **/
 
+    nRead++;
     if (pDe->d_ino == 0)                continue;
     if (strcmp(pDe->d_name, ".")  == 0) continue;
     if (strcmp(pDe->d_name, "..") == 0) continue;
@@ -465,51 +569,26 @@ static Froot *buildTree(
 
       crit = len - n_bExt;
       if (crit > 0   &&   strcmp(pDe->d_name + crit, bExt) == 0) {
+        PROBE3(entry_classified, dirName, pDe->d_name, 3);
         nuke(tName);
         continue;
       }
     }
 
-    /**
-     | If the file is a directory and the -r option has been given, stores
-     | the directory name in the linked list pointed to by "subDirs", for
-     | recursive calls.
-     |
-     | N.B.: if stat(2) fails, the file is skipped.
-    **/
-
-    if (stat(tName, &sStat) != 0) {
-      fprintf(stderr, "File \"%s", tName);
-      perror("\"");
-      continue;
-    }
-
-    if (S_ISDIR(sStat.st_mode) != 0) {
-
-      if (output_level >= DEBUG) {
-        printf("File %s - is a directory\n", pDe->d_name);
-      }
-
-      if (recurse) {
-        insertNode(tName, 0, 0, 0, subDirs);
-      }
-      continue;
-    }
-
     /**
      | If the file has an extension (the rightmost dot followed by at
-     | least one character), and if that extension matches one of the
-     | entries in teXTree[i].extension: stores the file name (with the
-     | extension stripped) in the appropriate linked list, together with
-     | its modification time.
+     | least one character), looks for it among the entries in
+     | teXTree[i].extension: "pTT" is left pointing to the matching one,
+     | if any.
     **/
 
-    if ((pFe = strrchr(pDe->d_name, '.')) != 0) {
-      size_t nameLen;
+    pTT     = 0;
+    nameLen = 0;
 
+    if ((pFe = strrchr(pDe->d_name, '.')) != 0) {
       nameLen = pFe - pDe->d_name;
       if (nameLen < last) {
-        Froot *pTT;
+        Froot *pExt;
 
         if (output_level >= DEBUG) {
           printf("File %s - extension %s", pDe->d_name, pFe);
@@ -519,19 +598,15 @@ static Froot *buildTree(
          | Loop on recognized TeX-related file extensions
         **/
 
-        for (pTT = teXTree;   pTT->extension != 0;   pTT++) {
-          if (strcmp(pFe, pTT->extension) == 0) {
-            insertNode(pDe->d_name, nameLen, sStat.st_mtime, access(tName, W_OK), pTT);
-
-            if (output_level >= DEBUG) {
-              printf(" - inserted in tree");
-            }
+        for (pExt = teXTree;   pExt->extension != 0;   pExt++) {
+          if (strcmp(pFe, pExt->extension) == 0) {
+            pTT = pExt;
             break;
           }
         } /* loop on known extensions */
 
         if (output_level >= DEBUG) {
-          puts("");
+          puts(pTT != 0 ? " - TeX related" : "");
         }
 
       } else {
@@ -545,6 +620,61 @@ static Froot *buildTree(
         printf("File %s - without extension\n", pDe->d_name);
       }
     }
+
+    PROBE3(entry_classified, dirName, pDe->d_name,
+           pTT == 0 ? 0 : (pTT == teXTree ? 1 : 2));
+
+    /**
+     | The other files matter only if they may be directories, to be
+     | scanned with the -r option: when readdir(3) tells the file type,
+     | the call to stat(2) is saved for everything else.
+    **/
+
+    if (pTT == 0) {
+      if (! recurse) continue;
+#ifdef DT_UNKNOWN
+      if (pDe->d_type != DT_DIR   &&   pDe->d_type != DT_LNK   &&
+          pDe->d_type != DT_UNKNOWN) {
+        continue;
+      }
+#endif
+    }
+
+    /**
+     | If the file is a directory and the -r option has been given, stores
+     | the directory name in the linked list pointed to by "subDirs", for
+     | recursive calls; a TeX-related file is stored (with the extension
+     | stripped) in the appropriate linked list, together with its
+     | modification time.
+     |
+     | N.B.: if stat(2) fails, the file is skipped.
+    **/
+
+    if (getAttributes(tName, &isDir, &mTime, &mNsec) != 0) {
+      fprintf(stderr, "File \"%s", tName);
+      perror("\"");
+      continue;
+    }
+
+    if (isDir) {
+
+      if (output_level >= DEBUG) {
+        printf("File %s - is a directory\n", pDe->d_name);
+      }
+
+      if (recurse) {
+        insertNode(tName, 0, 0, 0, subDirs);
+      }
+      continue;
+    }
+
+    if (pTT != 0) {
+      insertNode(pDe->d_name, nameLen, mTime, mNsec, pTT);
+
+      if (output_level >= DEBUG) {
+        printf("File %s - inserted in tree\n", pDe->d_name);
+      }
+    }
   }             /* while (readdir) ... */
 
   if (closedir(pDir) != 0) {
@@ -552,9 +682,79 @@ static Froot *buildTree(
     perror("\"");
   }
 
+  PROBE3(dir_close, dirName, nRead, started ? probeNs() - started : 0UL);
+
   return teXTree;
 }
 
+static int getAttributes(
+  char   *name,
+  int    *isDir,
+  time_t *mTime,
+  long   *mNsec
+){
+
+  /**
+   | Gets the type and the modification time of the file "name",
+   | returning what stat(2) would.  Where statx(2) is known, only those
+   | fields are asked for (a network file system may then answer
+   | without fetching the others); with the -n option, even without
+   | revalidating its cached attributes.  A kernel not knowing statx,
+   | or a file system not giving all those fields, gets stat.
+  **/
+
+  struct stat sStat;
+
+#ifdef STATX_TYPE
+  static int noStatx = FALSE;
+
+  if (! noStatx) {
+    const unsigned int mask = STATX_TYPE | STATX_MODE | STATX_MTIME;
+    struct statx       sx;
+
+    if (statx(AT_FDCWD, name,
+              noSync ? AT_STATX_DONT_SYNC : AT_STATX_SYNC_AS_STAT,
+              mask, &sx) == 0) {
+      if ((sx.stx_mask & mask) == mask) {
+        *isDir = S_ISDIR(sx.stx_mode);
+        *mTime = sx.stx_mtime.tv_sec;
+        *mNsec = sx.stx_mtime.tv_nsec;
+        return 0;
+      }
+    } else if (errno != ENOSYS) {
+      return -1;
+    } else {
+      noStatx = TRUE;
+    }
+  }
+#endif
+
+  if (stat(name, &sStat) != 0) {
+    return -1;
+  }
+  *isDir = S_ISDIR(sStat.st_mode);
+  *mTime = sStat.st_mtime;
+#ifdef _STATBUF_ST_NSEC
+  *mNsec = sStat.st_mtim.tv_nsec;
+#else
+  *mNsec = 0;
+#endif
+  return 0;
+}
+
+static unsigned long probeNs(void)
+{
+
+  /**
+   | The clock of the latencies given to the probes, in nanoseconds
+  **/
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
 static void printTree(
   Froot *teXTree
 ){
@@ -605,7 +805,9 @@ static void examineTree(
               DEBUG);
 
   for (pTeX = teXTree->firstNode;   pTeX != 0;   pTeX = pTeX->next) {
-    char tName[FILENAME_MAX];
+    char          tName[FILENAME_MAX];
+    unsigned long members = 0;          /* Outputs found, for the probes */
+    unsigned long removed = 0;          /*   and how many were removed   */
 
     sprintf(tName, "%s/%s.tex", dirName, pTeX->name);
     pTT = teXTree;
@@ -623,13 +825,19 @@ static void examineTree(
         if (strcmp(pTeX->name, pComp->name) == 0) {
           sprintf(cName, "%s/%s%s", dirName, pTeX->name, pTT->extension);
           pComp->name[0] = '\0';
+          members++;
 
           /**
            | Remove generated file if more recent than source (default) or if
            | we permit the removal of files older than source
           **/
-          if (difftime(pComp->mTime, pTeX->mTime) > 0.0 || older) {
-            if (pComp->write == 0) {
+          if (isNewer(pComp, pTeX) || older) {
+
+            /**
+             | The permission is asked only here, for the files that
+             | would be removed, and not for every file read
+            **/
+            if (access(cName, W_OK) == 0) {
               if (keep) {
                 Froot *kExt;
                 /**
@@ -651,17 +859,18 @@ static void examineTree(
                    | This is not a final TeX document. We can delete it
                   **/
                   nuke(cName);
+                  removed++;
                 } else {
                   printf("*** %s not removed; keep is enabled ***\n", cName);
                 }
               } else {
                 /* We don't care to keep final documents */
                 nuke(cName);
+                removed++;
               }
             } else {
               if (output_level >= DEBUG) {
-                printf("*** %s readonly; perms are %d***\n", cName,
-                       pComp->write);
+                printf("*** %s readonly ***\n", cName);
               }
               if (output_level >= VERBOSE) {
                 printf("*** %s not removed; it is read only ***\n", cName);
@@ -676,6 +885,8 @@ static void examineTree(
         }
       }
     }
+
+    PROBE4(family_decided, dirName, pTeX->name, members, removed);
   }
 
   /**
@@ -748,6 +959,10 @@ static void nuke(
    | Removes "name" (the fully qualified file name) from the file system
   **/
 
+  int           rc;             /* What remove(3) says   */
+  int           err;
+  unsigned long started = 0;    /* When it was called    */
+
   if ((output_level >= DEBUG) || pretend) {
     printf("*** File \"%s\" would have been removed ***\n", name);
   }
@@ -769,7 +984,17 @@ static void nuke(
     } while (c != 'y');
   }
 
-  if (remove(name) != 0) {
+  PROBE1(unlink_start, name);
+  if (PROBE_ENABLED(unlink_done)) started = probeNs();
+
+  rc  = remove(name);
+  err = errno;
+
+  PROBE3(unlink_done, name, rc == 0 ? 0 : err,
+         started ? probeNs() - started : 0UL);
+
+  if (rc != 0) {
+    errno = err;
     fprintf(stderr, "File \"%s", name);
     perror("\"");
   } else {
@@ -830,6 +1055,8 @@ static void syntax()
   puts("           remove them;");
   puts("  -k     : keeps final document (.pdf, .ps, .dvi);");
   puts("  -o     : permit removal of files older than their sources;");
+  puts("  -n     : takes the file attributes cached by network file systems,");
+  puts("           without asking the server;");
   puts("  -q     : quiet, only print error messages;");
   puts("  -v     : verbose, prints which files were removed and which weren't;");
   puts("  -d     : debug output, prints the answers to all of life's questions.");